@@ -19,6 +19,7 @@
 #include <algorithm>
 
 #define DEBUG false
+#define M4RM_MIN_ROWS 64 //products with fewer rows than this skip the Four Russians tables
 
 using namespace std;
 
@@ -94,36 +95,33 @@ public:
 
     /*
      * Function: randomInvertibleMatrix()
-     * Returns a random non-identity invertible BitMatrix
-     * Uses modified version of the algorithm by D. Randall
+     * Returns a uniformly random invertible BitMatrix (algorithm of D. Randall)
+     * Samples the factors of A * T one column of A and one row of T at a time: step i draws
+     * v uniformly among the non-zero vectors supported on the m = ROWS - i coordinates not yet
+     * picked (rejecting 0 only), picks r as the first of them in v, sets row r of T to v and
+     * column r of A to e_i plus uniform bits below row i. These 2^m - 1 times 2^(m-1) choices
+     * per step multiply out to |GL_ROWS(F_2)| and every product arises once, so each invertible
+     * matrix is equally likely. A is built transposed so both factors are filled word-wise
      */
 	static const BitMatrix<ROWS> randomInvertibleMatrix() {
-		BitMatrix<ROWS> A = BitMatrix<ROWS>::zeroMatrix();
+		BitMatrix<ROWS> At = BitMatrix<ROWS>::zeroMatrix();
 		BitMatrix<ROWS> T = BitMatrix<ROWS>::zeroMatrix();
-
-		unordered_set<int> usedRows;
-		unsigned int leadingZeroes = 0; //tracks the smallest unused r
-
-		for (int minorIndex = 0; minorIndex < ROWS; ++minorIndex) {
-			BitVector<ROWS> v = BitVector<ROWS>::randomVectorLeadingZeroes(leadingZeroes); //leading zeroes for performance
-			int r = v.getFirstOne();
-			while (usedRows.count(r) > 0 || r == -1) { //generate random nonzero vector v with unused first nonzero coord
-				v = BitVector<ROWS>::randomVectorLeadingZeroes(leadingZeroes);
-				r = v.getFirstOne();
-			}
-			A.set(minorIndex, r); //first row of minor set to e_r
-			BitVector<ROWS> randomVector = BitVector<ROWS>::randomVector(); //used to extract random values
-			for (int row = minorIndex + 1; row < ROWS; row++) {
-				if (randomVector[row]) A.set(row, r); //sets random bits below e_r in r-th column
-			}
-			for (auto it = usedRows.cbegin(); it != usedRows.cend(); ++it) {
-				v.clear(*it); //set intersection of row with prev cols to 0
-			}
-			T.setRow(r, v); //set rth row to v
-			usedRows.insert(r);
-			while (usedRows.count(leadingZeroes) > 0) ++leadingZeroes; //update leadingZeroes
+		BitVector<ROWS> unused = BitVector<ROWS>::zeroVector(); //coordinates not picked as r yet
+		for (unsigned int i = 0; i < ROWS; ++i) unused.set(i);
+		BitVector<ROWS> below = unused; //rows after the current step
+
+		for (unsigned int minorIndex = 0; minorIndex < ROWS; ++minorIndex) {
+			BitVector<ROWS> v = BitVector<ROWS>::randomVector() & unused;
+			while (v.isZero()) v = BitVector<ROWS>::randomVector() & unused;
+			const int r = v.getFirstOne();
+
+			below.clear(minorIndex);
+			At[r] = BitVector<ROWS>::randomVector() & below; //random bits below e_r in column r of A
+			At[r].set(minorIndex);
+			T[r] = v;
+			unused.clear(r);
 		}
-		return A*T;
+		return At.transpose() * T;
 	}
 
     /*
@@ -164,14 +162,14 @@ public:
 			for (int i = 0; i < ROWS - 1; ++i)
 			{
 				unsigned int ran;
-				std::fread(&ran, sizeof( unsigned int),1,urandom);
+				ran = RandomGenerator::local().nextInt();
 				unsigned int nnz = ran % min(num, ROWS - i);
 				for (int j = 0; j < nnz; ++j)
 				{
 					int b = i;
 					while (b <= i || result.get(i, b)) 
 					{
-						std::fread(&ran, sizeof( unsigned int),1,urandom);
+						ran = RandomGenerator::local().nextInt();
 						b = ran % ROWS;
 					}
 					result.set(i, b);				
@@ -227,7 +225,12 @@ public:
      * Returns the result of bitwise XOR between matrices
      */
 	const BitMatrix<ROWS,COLS> operator^(const BitMatrix<ROWS,COLS> & rhs) const{
-		BitMatrix<ROWS,COLS> result = *this;
+		BitMatrix<ROWS,COLS> result;
+		if (ROWS * WORDS_PER_ROW >= SIMD_MIN_WORDS) { //the rows are contiguous, so the whole matrix is one word array
+			SimdKernels::get().xorWords(result._rows[0].elements(), _rows[0].elements(), rhs._rows[0].elements(), ROWS * WORDS_PER_ROW);
+			return result;
+		}
+		result = *this;
 		for (size_t i = 0; i < ROWS; ++i) {
 			result._rows[i] ^= rhs._rows[i];
 		}
@@ -237,9 +240,21 @@ public:
 	/*
      * Operator: *
      * Returns the result of matrix * matrix multiplication
+     * Uses the Method of Four Russians once there are enough rows to amortize its tables
      */
 	template <unsigned int NEWCOLS>
 	const BitMatrix<ROWS,NEWCOLS> operator*(const BitMatrix<COLS,NEWCOLS> & rhs) const{
+		if (ROWS >= M4RM_MIN_ROWS) return m4rmMult<NEWCOLS>(rhs);
+		return naiveMult<NEWCOLS>(rhs);
+	}
+
+	/*
+     * Function: naiveMult(rhs)
+     * Returns the result of matrix * matrix multiplication computed one bit at a time
+     * Kept as the reference implementation for m4rmMult
+     */
+	template <unsigned int NEWCOLS>
+	const BitMatrix<ROWS,NEWCOLS> naiveMult(const BitMatrix<COLS,NEWCOLS> & rhs) const{
 		BitMatrix<ROWS,NEWCOLS> result = BitMatrix<ROWS,NEWCOLS>::zeroMatrix();
 		for (unsigned int i = 0; i < ROWS; ++i) {
 			for (unsigned int j = 0; j < COLS ; ++j) {
@@ -251,17 +266,65 @@ public:
 		return result;
 	}
 
+	/*
+     * Function: m4rmMult(rhs)
+     * Returns the result of matrix * matrix multiplication by the Method of Four Russians
+     * For every chunk of 8 rows of rhs, all 256 sums of those rows are tabulated in Gray code
+     * order (one row XOR each), then every row of the result adds in the sum selected by
+     * the matching 8 bits of the current row
+     */
+	template <unsigned int NEWCOLS>
+	const BitMatrix<ROWS,NEWCOLS> m4rmMult(const BitMatrix<COLS,NEWCOLS> & rhs) const{
+		BitMatrix<ROWS,NEWCOLS> result = BitMatrix<ROWS,NEWCOLS>::zeroMatrix();
+		vector<BitVector<NEWCOLS> > table(256);
+		table[0].zero();
+		for (unsigned int start = 0; start < COLS; start += 8) {
+			const unsigned int width = min(8u, COLS - start);
+			const unsigned int size = 1u << width;
+			for (unsigned int i = 1; i < size; ++i) {
+				//gray(i) differs from gray(i - 1) in exactly the lowest set bit of i
+				table[i ^ (i >> 1)] = table[(i - 1) ^ ((i - 1) >> 1)] ^ rhs[start + __builtin_ctz(i)];
+			}
+			const unsigned int word = start >> 6;
+			const unsigned int shift = start & 63;
+			const unsigned long long mask = size - 1;
+			for (unsigned int i = 0; i < ROWS; ++i) {
+				const unsigned int index = (_rows[i].elements()[word] >> shift) & mask;
+				if (index) result[i] ^= table[index];
+			}
+		}
+		return result;
+	}
+
 	/*
      * Operator: *
      * Returns the result of matrix * vector multiplication
      */
 	BitVector<ROWS> operator*(const BitVector<COLS> &v) const{
 		BitVector<ROWS> result = BitVector<ROWS>::zeroVector();
-		for (unsigned int i = 0; i < ROWS; ++i) {
-			BitVector<COLS> prod = _rows[i] & v;
-			if (prod.parity()) {
-				result.set(i);
+		//four rows per pass over v, accumulating row & v in registers instead of temporaries
+		const unsigned long long * x = v.elements();
+		unsigned long long * out = result.elements();
+		unsigned int i = 0;
+		for (; i + 4 <= ROWS; i += 4) {
+			const unsigned long long * r0 = _rows[i].elements();
+			const unsigned long long * r1 = _rows[i + 1].elements();
+			const unsigned long long * r2 = _rows[i + 2].elements();
+			const unsigned long long * r3 = _rows[i + 3].elements();
+			unsigned long long a0 = 0, a1 = 0, a2 = 0, a3 = 0;
+			for (unsigned int w = 0; w < WORDS_PER_ROW; ++w) {
+				a0 ^= r0[w] & x[w];
+				a1 ^= r1[w] & x[w];
+				a2 ^= r2[w] & x[w];
+				a3 ^= r3[w] & x[w];
 			}
+			const unsigned long long bits = __builtin_parityll(a0) | (__builtin_parityll(a1) << 1) | (__builtin_parityll(a2) << 2) | (__builtin_parityll(a3) << 3);
+			out[i >> 6] |= bits << (i & 63); //i is a multiple of 4, so the 4 bits share a word
+		}
+		for (; i < ROWS; ++i) {
+			unsigned long long a = 0;
+			for (unsigned int w = 0; w < WORDS_PER_ROW; ++w) a ^= _rows[i].elements()[w] & x[w];
+			if (__builtin_parityll(a)) result.set(i);
 		}
 		return result;
 	}
@@ -278,6 +341,14 @@ public:
 		return true;
 	}
 
+	/*
+     * Function: isZero()
+     * Returns whether every entry is 0, including any bits past COLS in each row
+     */
+	bool isZero() const{
+		return SimdKernels::get().isZero(_rows[0].elements(), ROWS * WORDS_PER_ROW);
+	}
+
 	/*
 	 * Function: |
 	 * Returns ther result of matrix OR matrix operation
@@ -317,12 +388,21 @@ public:
     /*
      * Function: getCol(colIndex)
      * Returns a given column as a BitVector
+     * Gathers the bit of 64 rows into each word of the result
      */
 	const BitVector<ROWS> getCol(const unsigned int colIndex) const{
 		if (DEBUG) assert(colIndex >= 0 && colIndex < COLS);
-		BitVector<ROWS> v = BitVector<ROWS>::zeroVector();
-		for (unsigned int i = 0; i < ROWS; ++i) {
-			if (get(i, colIndex)) v.set(i);
+		BitVector<ROWS> v;
+		unsigned long long * out = v.elements();
+		const unsigned int word = colIndex >> 6;
+		const unsigned int shift = colIndex & 63;
+		for (unsigned int start = 0; start < ROWS; start += 64) {
+			const unsigned int end = min(start + 64, ROWS);
+			unsigned long long gathered = 0;
+			for (unsigned int i = start; i < end; ++i) {
+				gathered |= ((_rows[i].elements()[word] >> shift) & 1ull) << (i - start);
+			}
+			out[start >> 6] = gathered;
 		}
 		return v;
 	}
@@ -555,15 +635,11 @@ public:
 	/*
 	 * Function: transpose()
 	 * Returns the transpose of a matrix.
+	 * Works on 64x64 blocks, each transposed in registers by transposeBlock
 	 */
 	const BitMatrix<COLS,ROWS> transpose() const {
-		BitMatrix<COLS,ROWS> Mt = BitMatrix<COLS,ROWS>::zeroMatrix();
-
-        for (unsigned int i = 0; i < ROWS; ++i) {
-			for (unsigned int j = 0; j < COLS; ++j) {
-				if (get(i, j)) Mt.set(j, i);
-			}
-		}
+		BitMatrix<COLS,ROWS> Mt;
+		transposeRows<ROWS>(0, Mt);
 		return Mt;
 	}
 
@@ -573,18 +649,27 @@ public:
 	 */
     template<unsigned int START_ROW>
     const BitMatrix<COLS,ROWS-START_ROW> trimAndTranpose() const {
-        BitMatrix<COLS,ROWS-START_ROW> Mt = BitMatrix<COLS,ROWS-START_ROW>::zeroMatrix();
-
-        for (int i = 0; i < (ROWS-START_ROW); ++i) {
-            for (int j = 0; j < COLS; ++j) {
-                if ( get(i + START_ROW, j) ) {
-                    Mt.set(j, i);
-                }
-            }
-        }
+        BitMatrix<COLS,ROWS-START_ROW> Mt;
+        transposeRows<ROWS-START_ROW>(START_ROW, Mt);
         return Mt;
     }
 
+	/*
+	 * Function: transposeBlock(block)
+	 * Transposes a 64x64 bit block in place, bit c of block[r] being entry (r, c)
+	 * Swaps the off-diagonal 32x32 quadrants, then 16x16 ones within each, down to single bits
+	 */
+	static void transposeBlock(unsigned long long block[64]) {
+		unsigned long long mask = 0x00000000FFFFFFFFull;
+		for (unsigned int width = 32; width != 0; width >>= 1, mask ^= mask << width) {
+			for (unsigned int k = 0; k < 64; k = ((k | width) + 1) & ~width) {
+				const unsigned long long t = ((block[k] >> width) ^ block[k | width]) & mask;
+				block[k] ^= t << width;
+				block[k | width] ^= t;
+			}
+		}
+	}
+
 	/*
      * Function: inv()
      * Returns the inverse of a square matrix
@@ -603,8 +688,9 @@ public:
      */
 	const BitMatrix<ROWS> inv(bool & invertible) const{
 		if (DEBUG) assert(ROWS==COLS);
+		BitMatrix<ROWS,COLS> A = *this;
 		BitMatrix<ROWS> I = BitMatrix<ROWS>::identityMatrix();
-		rref(I);
+		invertible = m4riReduce<ROWS>(A, &I[0]) == ROWS;
 		return I;
 	}
 
@@ -752,9 +838,32 @@ public:
 
 	/*
      * Function: rref()
-     * Returns the reduced row-echelon form of a given matrix by Gaussian elimination
+     * Returns the reduced row-echelon form of a given matrix
+     * Eliminates 8 pivots per pass with the Method of Four Russians (see m4riReduce)
      */
 	const BitMatrix<ROWS,COLS> rref() const{
+		BitMatrix<ROWS,COLS> A = *this;
+		m4riReduce(A._rows[0].elements(), ROWS, WORDS_PER_ROW, COLS);
+		return A;
+	}
+
+	/*
+     * Function: rref(rhs)
+     * Returns the reduced row-echelon form of a given matrix
+     * Applies the same row operations to rhs, which becomes the inverse when the matrix is invertible
+     */
+	const BitMatrix<ROWS, COLS> rref(BitMatrix<ROWS> & rhs) const{
+		BitMatrix<ROWS,COLS> A = *this;
+		m4riReduce<ROWS>(A, &rhs[0]);
+		return A;
+	}
+
+	/*
+     * Function: naiveRref()
+     * Returns the reduced row-echelon form of a given matrix by Gaussian elimination one column at a time
+     * Kept as the reference implementation for rref; rows past COLS are left unreduced
+     */
+	const BitMatrix<ROWS,COLS> naiveRref() const{
 		int row = 0;
 		BitMatrix<ROWS,COLS> A = *this;
 		int limit = min(ROWS, COLS);
@@ -778,10 +887,11 @@ public:
 	}
 
 	/*
-     * Function: rref(rhs)
-     * Returns the reduced row-echelon form of a given matrix by Gaussian elimination
+     * Function: naiveRref(rhs)
+     * Returns the reduced row-echelon form of a given matrix by Gaussian elimination one column at a time
+     * Kept as the reference implementation for rref(rhs)
      */
-	const BitMatrix<ROWS, COLS> rref(BitMatrix<ROWS> & rhs) const{
+	const BitMatrix<ROWS, COLS> naiveRref(BitMatrix<ROWS> & rhs) const{
 		int row = 0;
 		BitMatrix<ROWS,COLS> A = *this;
 		int limit = min(ROWS, COLS);
@@ -840,32 +950,32 @@ public:
 	 */
 	void randomSwap() {
 		unsigned int ran;
-		std::fread(&ran, sizeof( unsigned int),1,urandom);
+		ran = RandomGenerator::local().nextInt();
 		int num = ran % (ROWS * ROWS);
 		for (int i = 0; i < num; ++i)
 		{
-			std::fread(&ran, sizeof( unsigned int),1,urandom);
+			ran = RandomGenerator::local().nextInt();
 			int rowIndex = ran % ROWS;
 			int colIndex = rowIndex;
 			while (colIndex == rowIndex) 
 			{
-				std::fread(&ran, sizeof( unsigned int),1,urandom);
+				ran = RandomGenerator::local().nextInt();
 				colIndex = ran % ROWS;
 			}
 			swapRows(rowIndex, colIndex);
 		}
 
 		*this = (*this).transpose();
-		std::fread(&ran, sizeof( unsigned int),1,urandom);
+		ran = RandomGenerator::local().nextInt();
 		num = ran % (ROWS * ROWS);
 		for (int i = 0; i < num; ++i)
 		{
-			std::fread(&ran, sizeof( unsigned int),1,urandom);
+			ran = RandomGenerator::local().nextInt();
 			int rowIndex = ran % ROWS;
 			int colIndex = rowIndex;
 			while (colIndex == rowIndex) 
 			{
-				std::fread(&ran, sizeof( unsigned int),1,urandom);
+				ran = RandomGenerator::local().nextInt();
 				colIndex = ran % ROWS;
 			}
 			swapRows(rowIndex, colIndex);
@@ -911,9 +1021,34 @@ public:
      * Returns the vector result of multiplication by the inverse of the current matrix if invertible
      * Returns zero vector and prints error otherwise
      * Ex. A.solve(v) = A^{-1} v
+     * Reduces the augmented matrix [A | v] with m4riReduce
      * Marks if the current matrix is invertible
      */
 	const BitVector<ROWS> solve (const BitVector<ROWS> & rhs, bool & solvable) const{
+		if (DEBUG) assert(ROWS == COLS);
+		BitMatrix<ROWS,COLS> A = *this;
+		BitVector<1> b[ROWS]; //rhs as a column
+		for (unsigned int i = 0; i < ROWS; ++i) {
+			b[i].zero();
+			if (rhs.get(i)) b[i].set(0);
+		}
+		if (m4riReduce<1>(A, b) < ROWS) {
+			throw std::invalid_argument("Error: solving system of a singular matrix!");
+		}
+		BitVector<ROWS> x = BitVector<ROWS>::zeroVector();
+		for (unsigned int i = 0; i < ROWS; ++i) {
+			if (b[i].get(0)) x.set(i);
+		}
+		solvable = true;
+		return x;
+	}
+
+	/*
+     * Function: naiveSolve(rhs, solvable)
+     * Same as solve(rhs, solvable) by Gaussian elimination and back substitution one bit at a time
+     * Kept as the reference implementation for solve
+     */
+	const BitVector<ROWS> naiveSolve(const BitVector<ROWS> & rhs, bool & solvable) const{
 		if (DEBUG) assert(ROWS == COLS);
 		BitMatrix<ROWS> A = *this;
 		BitVector<ROWS> b = rhs;
@@ -1417,6 +1552,120 @@ public:
 	// }
 
 private:
+	static const unsigned int WORDS_PER_ROW = (COLS + 63) >> 6;
+
+	/*
+	 * Function: transposeRows(startRow, Mt)
+	 * Writes the transpose of rows [startRow, startRow + NUM_ROWS) into Mt, one 64x64 block at a time
+	 * Bits past NUM_ROWS in the rows of Mt are zero
+	 */
+	template<unsigned int NUM_ROWS>
+	void transposeRows(const unsigned int startRow, BitMatrix<COLS,NUM_ROWS> & Mt) const {
+		unsigned long long block[64];
+		for (unsigned int rowBlock = 0; rowBlock < NUM_ROWS; rowBlock += 64) {
+			const unsigned int height = min(64u, NUM_ROWS - rowBlock);
+			for (unsigned int colBlock = 0; colBlock < COLS; colBlock += 64) {
+				for (unsigned int r = 0; r < 64; ++r) {
+					block[r] = r < height ? _rows[startRow + rowBlock + r].elements()[colBlock >> 6] : 0;
+				}
+				transposeBlock(block);
+				const unsigned int width = min(64u, COLS - colBlock);
+				for (unsigned int c = 0; c < width; ++c) {
+					Mt[colBlock + c].elements()[rowBlock >> 6] = block[c];
+				}
+			}
+		}
+	}
+
+	/*
+	 * Function: m4riReduce(rows, numRows, numWords, numCols)
+	 * Brings numRows rows of numWords words into reduced row-echelon form in their first numCols
+	 * columns by the Method of Four Russians; any further columns follow the row operations
+	 * Up to 8 pivots are found by plain elimination among the rows below the current rank, then
+	 * the 256 sums of those pivot rows are tabulated in Gray code order (as in m4rmMult) and every
+	 * other row clears its pivot columns with one lookup and one row XOR
+	 * Returns the rank
+	 */
+	static unsigned int m4riReduce(unsigned long long * rows, const unsigned int numRows, const unsigned int numWords, const unsigned int numCols) {
+		vector<unsigned long long> table(256 * numWords);
+		unsigned int pivots[8];
+		unsigned int rank = 0, col = 0;
+		while (col < numCols && rank < numRows) {
+			const unsigned int first = col >> 6; //rows from rank on are zero before column col, so before this word
+			unsigned int found = 0;
+			for (; found < 8 && col < numCols && rank + found < numRows; ++col) {
+				unsigned long long * pivot = rows + (rank + found) * numWords;
+				unsigned int i = rank + found;
+				for (; i < numRows; ++i) {
+					unsigned long long * row = rows + i * numWords;
+					for (unsigned int t = 0; t < found; ++t) {
+						if (rowBit(row, pivots[t])) xorWords(row, rows + (rank + t) * numWords, first, numWords);
+					}
+					if (rowBit(row, col)) break;
+				}
+				if (i == numRows) continue; //no pivot in this column
+				if (i != rank + found) swap_ranges(pivot + first, pivot + numWords, rows + i * numWords + first);
+				for (unsigned int t = 0; t < found; ++t) { //keeps the pivots of this pass reduced against each other
+					unsigned long long * other = rows + (rank + t) * numWords;
+					if (rowBit(other, col)) xorWords(other, pivot, first, numWords);
+				}
+				pivots[found++] = col;
+			}
+			if (found == 0) break;
+			const unsigned int size = 1u << found;
+			fill(table.begin(), table.begin() + numWords, 0ULL);
+			for (unsigned int g = 1; g < size; ++g) {
+				//gray(g) differs from gray(g - 1) in exactly the lowest set bit of g
+				unsigned long long * entry = &table[(g ^ (g >> 1)) * numWords];
+				const unsigned long long * previous = &table[((g - 1) ^ ((g - 1) >> 1)) * numWords];
+				const unsigned long long * pivot = rows + (rank + __builtin_ctz(g)) * numWords;
+				for (unsigned int w = first; w < numWords; ++w) entry[w] = previous[w] ^ pivot[w];
+			}
+			for (unsigned int i = 0; i < numRows; ++i) {
+				if (i == rank) {
+					i += found - 1;
+					continue;
+				}
+				unsigned long long * row = rows + i * numWords;
+				unsigned int index = 0;
+				for (unsigned int t = 0; t < found; ++t) index |= rowBit(row, pivots[t]) << t;
+				if (index) xorWords(row, &table[index * numWords], first, numWords);
+			}
+			rank += found;
+		}
+		return rank;
+	}
+
+	/*
+	 * Function: m4riReduce(A, rhs)
+	 * Reduces A with rows of rhs (ROWS vectors) appended to its rows, writes both back
+	 * Returns the rank of A
+	 */
+	template<unsigned int RHS_COLS>
+	static unsigned int m4riReduce(BitMatrix<ROWS,COLS> & A, BitVector<RHS_COLS> * rhs) {
+		const unsigned int rhsWords = (RHS_COLS + 63) >> 6;
+		const unsigned int numWords = WORDS_PER_ROW + rhsWords;
+		vector<unsigned long long> rows(ROWS * numWords);
+		for (unsigned int i = 0; i < ROWS; ++i) {
+			memcpy(&rows[i * numWords], A._rows[i].elements(), WORDS_PER_ROW * sizeof(unsigned long long));
+			memcpy(&rows[i * numWords + WORDS_PER_ROW], rhs[i].elements(), rhsWords * sizeof(unsigned long long));
+		}
+		const unsigned int rank = m4riReduce(&rows[0], ROWS, numWords, COLS);
+		for (unsigned int i = 0; i < ROWS; ++i) {
+			memcpy(A._rows[i].elements(), &rows[i * numWords], WORDS_PER_ROW * sizeof(unsigned long long));
+			memcpy(rhs[i].elements(), &rows[i * numWords + WORDS_PER_ROW], rhsWords * sizeof(unsigned long long));
+		}
+		return rank;
+	}
+
+	static inline unsigned int rowBit(const unsigned long long * row, const unsigned int col) {
+		return (row[col >> 6] >> (col & 63)) & 1;
+	}
+
+	static inline void xorWords(unsigned long long * dst, const unsigned long long * src, const unsigned int start, const unsigned int end) {
+		for (unsigned int w = start; w < end; ++w) dst[w] ^= src[w];
+	}
+
 	BitVector<COLS> _rows[ROWS];
 
     /*
@@ -15,14 +15,12 @@
 #include <string>
 #include <cstring>
 #include <assert.h>
+#include "Random.h"
+#include "SimdKernels.h"
 #define _KBV_N_ ((NUM_BITS + 63) >> 6) //rounds up to nearest multiple of 64
 
 using namespace std;
 
-//TODO: Wrap this in a class that can release the file handle and automatically select a good source of randomness on Windows.
-//file pointer urandom must be closed by any class importing BitVector
-static FILE * urandom = std::fopen("/dev/urandom", "rb" );
-
 /*
  * Template for BitVector
  * Bit values are stored in an array of N many 64-bit longs
@@ -39,8 +37,7 @@ public:
      * Returns a zero-initialized BitVector
      */
     static const BitVector<NUM_BITS> & zeroVector() {
-        static BitVector<NUM_BITS> v;
-        v.zero();
+        static BitVector<NUM_BITS> v; //zero-initialized once, being static, so concurrent callers only read it
         return v;
     }
 
@@ -49,11 +46,7 @@ public:
      * Returns the all-one BitVector
      */
     static const BitVector<NUM_BITS> & allOneVector() {
-        static BitVector<NUM_BITS> v;
-        for (int i = 0; i < NUM_BITS; ++i)
-        {
-            v.set(i);
-        }
+        static const BitVector<NUM_BITS> v = filledVector(); //built once, so concurrent callers only read it
         return v;
     }
 
@@ -64,7 +57,7 @@ public:
     static const BitVector<NUM_BITS> randomVector() {
         BitVector<NUM_BITS> result = BitVector<NUM_BITS>::zeroVector();
         while( result.isZero() ) {
-            std::fread(&result._bits, sizeof( unsigned long long ),_KBV_N_, urandom );
+            RandomGenerator::local().fill(result._bits, sizeof(result._bits));
         }
         return result;     
     }
@@ -109,6 +102,10 @@ public:
      */
     const BitVector<NUM_BITS> operator&(const BitVector<NUM_BITS> & rhs) const {
         BitVector<NUM_BITS> result;
+        if (_KBV_N_ >= SIMD_MIN_WORDS) {
+            SimdKernels::get().andWords(result._bits, _bits, rhs._bits, _KBV_N_);
+            return result;
+        }
         for (unsigned int i = 0; i < _KBV_N_; ++i) {
             result._bits[i] = _bits[i] & rhs._bits[i];
         }
@@ -133,6 +130,10 @@ public:
      */
     const BitVector<NUM_BITS> operator^(const BitVector<NUM_BITS> & rhs) const {
         BitVector<NUM_BITS> result;
+        if (_KBV_N_ >= SIMD_MIN_WORDS) {
+            SimdKernels::get().xorWords(result._bits, _bits, rhs._bits, _KBV_N_);
+            return result;
+        }
         for (unsigned int i = 0; i < _KBV_N_; ++i) {
             result._bits[i] = _bits[i] ^ rhs._bits[i];
         }
@@ -142,23 +143,17 @@ public:
     /*
      * Operator: +
      * Returns a BitVector with values resulting from add with carry on
+     * Carries are resolved with a Kogge-Stone prefix over whole words, in log2(NUM_BITS) rounds
      */
     const BitVector<NUM_BITS> operator+(const BitVector<NUM_BITS> & rhs) const{
-        BitVector<NUM_BITS> currentLHS;
-        for(int i = 0; i < _KBV_N_; ++i)
-            currentLHS._bits[i] = _bits[i];
-        BitVector<NUM_BITS> currentRHS = rhs;
-        
-        BitVector<NUM_BITS> sum = currentLHS ^ currentRHS;
-        BitVector<NUM_BITS> carry = currentLHS & currentRHS;
-        
-        while (!carry.isZero()) {
-            currentLHS = sum;
-            currentRHS = carry.leftShift(); //this can be accelerated later;
-            sum = currentLHS ^ currentRHS; 
-            carry = currentLHS & currentRHS; 
+        BitVector<NUM_BITS> generate = *this & rhs;
+        BitVector<NUM_BITS> propagate = *this ^ rhs;
+        const BitVector<NUM_BITS> sum = propagate;
+        for (unsigned int d = 1; d < NUM_BITS; d <<= 1) {
+            generate ^= propagate & generate.leftShift(d); //generate and propagate & generate never overlap
+            propagate &= propagate.leftShift(d);
         }
-        return sum;
+        return sum ^ generate.leftShift();
     }
 
     /*
@@ -166,17 +161,16 @@ public:
      * Returns a BitVector with values resulting from integer multiplication in base 2
      */
     const BitVector<NUM_BITS> operator*(const BitVector<NUM_BITS> & rhs) const{
-        BitVector<NUM_BITS> shiftedLHS;
-        for (unsigned int i = 0; i <_KBV_N_; ++i) {
-            shiftedLHS._bits[i] = _bits[i];
-        }        
         BitVector<NUM_BITS> prod;
         prod.zero();
-        for(int i = 0; i < NUM_BITS; ++i){
-            if(rhs.get(NUM_BITS - 1 - i)){
-                prod = prod + shiftedLHS; 
+        for (unsigned int i = 0; i < _KBV_N_; ++i) {
+            unsigned long long word = rhs._bits[i];
+            while (word) {
+                const unsigned int j = (i << 6) + __builtin_ctzll(word);
+                if (j >= NUM_BITS) break;
+                prod = prod + leftShift(NUM_BITS - 1 - j);
+                word &= word - 1;
             }
-            shiftedLHS = shiftedLHS.leftShift();
         }
         return prod;
     }
@@ -199,6 +193,10 @@ public:
      * Returns the current BitVector
      */
     BitVector<NUM_BITS> & operator&=(const BitVector<NUM_BITS> & rhs) {
+        if (_KBV_N_ >= SIMD_MIN_WORDS) {
+            SimdKernels::get().andWords(_bits, _bits, rhs._bits, _KBV_N_);
+            return *this;
+        }
         for (unsigned int i = 0; i < _KBV_N_; ++i) {
             _bits[i] &= rhs._bits[i];
         }
@@ -211,6 +209,10 @@ public:
      * Returns the current BitVector
      */
     BitVector<NUM_BITS> & operator^=(const BitVector<NUM_BITS> & rhs) {
+        if (_KBV_N_ >= SIMD_MIN_WORDS) {
+            SimdKernels::get().xorInto(_bits, rhs._bits, _KBV_N_);
+            return *this;
+        }
         for (unsigned int i = 0; i < _KBV_N_; ++i) {
             _bits[i] ^= rhs._bits[i];
         }
@@ -280,6 +282,7 @@ public:
      * Returns 0 otherwise.
      */
     const bool parity() const {
+        if (_KBV_N_ >= SIMD_MIN_WORDS) return SimdKernels::get().parity(_bits, _KBV_N_);
         unsigned long long accumulator = 0;
         for (unsigned int i = 0; i < _KBV_N_; ++i) {
             accumulator ^= _bits[i];
@@ -292,6 +295,7 @@ public:
      * Returns whether the current BitVector is a zero vector
      */
     const bool isZero() const {
+        if (_KBV_N_ >= SIMD_MIN_WORDS) return SimdKernels::get().isZero(_bits, _KBV_N_);
         for (unsigned int i = 0; i <_KBV_N_; ++i) {
             if (_bits[i] != 0) {
                 return false;
@@ -324,8 +328,11 @@ public:
      * Returns -1 if all bits are 0
      */
     int getFirstOne() const {
-        for (int i = 0; i < NUM_BITS; ++i) {
-            if (get(i)) return i;
+        for (unsigned int i = 0; i < _KBV_N_; ++i) {
+            if (_bits[i] != 0) {
+                const int index = (i << 6) + __builtin_ctzll(_bits[i]);
+                return index < NUM_BITS ? index : -1; //a set bit past NUM_BITS is padding
+            }
         }
         return -1;
     }
@@ -361,13 +368,18 @@ public:
      * Function: dot(rhs)
      * Returns the dot product of the current BitVector with an
      * input BitVector
+     * Parity of the word-wise AND; bits past NUM_BITS in the last word are masked out
      */
     bool dot(const BitVector<NUM_BITS> & rhs) const {
-        bool result = 0;
-        for(int i = 0; i < NUM_BITS; ++i){
-            result ^= (get(i) & rhs.get(i));
+        const unsigned long long lastMask = (NUM_BITS & 63) ? (1ull << (NUM_BITS & 63)) - 1 : ~0ull;
+        unsigned long long accumulator = _bits[_KBV_N_ - 1] & rhs._bits[_KBV_N_ - 1] & lastMask;
+        if (_KBV_N_ >= SIMD_MIN_WORDS) {
+            return SimdKernels::get().andParity(_bits, rhs._bits, _KBV_N_ - 1) ^ __builtin_parityll(accumulator);
         }
-        return result;
+        for (unsigned int i = 0; i + 1 < _KBV_N_; ++i) {
+            accumulator ^= _bits[i] & rhs._bits[i];
+        }
+        return __builtin_parityll(accumulator);
     }
 
     /*
@@ -485,11 +497,8 @@ public:
      * Returns a BitVector with the values of the current BitVector
      * shifted to the left once and trailing zeroes
      */
-    const BitVector<NUM_BITS> leftShift(){
-        BitVector<NUM_BITS> result = BitVector<NUM_BITS>::zeroVector();
-        for(unsigned int i = 0; i < NUM_BITS - 1; ++i)
-            result.set(i, get(i + 1));
-        return result;
+    const BitVector<NUM_BITS> leftShift() const{
+        return leftShift(1);
     }
 
     /*
@@ -497,22 +506,28 @@ public:
      * Returns a BitVector with the values of the current BitVector
      * shifted to the right once and preceeding zeros
      */
-    const BitVector<NUM_BITS> rightShift(){
-        BitVector<NUM_BITS> result = BitVector<NUM_BITS>::zeroVector();
-        for(unsigned int i = NUM_BITS; i >= 1; --i)
-            result.set(i, get(i - 1));
-        return result;        
+    const BitVector<NUM_BITS> rightShift() const{
+        return rightShift(1);
     }
 
     /*
      * Function: leftShift(n)
      * Returns a BitVector with the values of the current BitVector
      * shifted to the left by n and trailing zeroes
+     * Bit i lives in word i / 64 at position i % 64, so this shifts words towards lower positions
      */
-    const BitVector<NUM_BITS> leftShift(unsigned int n){
-        BitVector<NUM_BITS> result = BitVector<NUM_BITS>::zeroVector();
-        for(unsigned int i = 0; i < NUM_BITS - n; ++i)
-            result.set(i, get(i + n));
+    const BitVector<NUM_BITS> leftShift(unsigned int n) const{
+        BitVector<NUM_BITS> result;
+        result.zero();
+        if (n >= NUM_BITS) return result;
+        const unsigned int words = n >> 6;
+        const unsigned int offset = n & 63;
+        for (unsigned int i = 0; i + words < _KBV_N_; ++i) {
+            result._bits[i] = _bits[i + words] >> offset;
+            if (offset && i + words + 1 < _KBV_N_)
+                result._bits[i] |= _bits[i + words + 1] << (64 - offset);
+        }
+        result.clearFrom(NUM_BITS - n);
         return result;
     }
 
@@ -521,11 +536,19 @@ public:
      * Returns a BitVector with the values of the current BitVector
      * shifted to the right by n and preceeding zeros
      */
-    const BitVector<NUM_BITS> rightShift(unsigned int n){
-        BitVector<NUM_BITS> result = BitVector<NUM_BITS>::zeroVector();
-        for(unsigned int i = NUM_BITS; i >= n; --i)
-            result.set(i, get(i - n));
-        return result;        
+    const BitVector<NUM_BITS> rightShift(unsigned int n) const{
+        BitVector<NUM_BITS> result;
+        result.zero();
+        if (n >= NUM_BITS) return result;
+        const unsigned int words = n >> 6;
+        const unsigned int offset = n & 63;
+        for (unsigned int i = words; i < _KBV_N_; ++i) {
+            result._bits[i] = _bits[i - words] << offset;
+            if (offset && i > words)
+                result._bits[i] |= _bits[i - words - 1] >> (64 - offset);
+        }
+        result.clearFrom(NUM_BITS);
+        return result;
     }
 
 /* Print */
@@ -548,16 +571,36 @@ public:
      * Returns the number of nonzero entries
      */
     const unsigned int nnz() const {
-        unsigned int res = 0;
-        for (int i = 0; i < NUM_BITS; ++i)
-        {
-            res += get(i);
-        }
-        return res;
+        const unsigned long long last = (NUM_BITS & 63) ? _bits[_KBV_N_ - 1] & ((1ull << (NUM_BITS & 63)) - 1) : _bits[_KBV_N_ - 1]; //skip padding bits
+        return SimdKernels::get().popcount(_bits, _KBV_N_ - 1) + __builtin_popcountll(last);
     }
 
 private:
     unsigned long long _bits[_KBV_N_]; //array of bit values
+
+    /*
+     * Function: clearFrom(n)
+     * Clears bits n and above, including the padding of the last word
+     */
+    void clearFrom(unsigned int n){
+        for (unsigned int i = (n + 63) >> 6; i < _KBV_N_; ++i) {
+            _bits[i] = 0;
+        }
+        if (n & 63) _bits[n >> 6] &= (1ull << (n & 63)) - 1;
+    }
+
+    /*
+     * Function: filledVector()
+     * Returns a BitVector with all NUM_BITS bits set
+     */
+    static const BitVector<NUM_BITS> filledVector() {
+        BitVector<NUM_BITS> v;
+        v.zero();
+        for (int i = 0; i < NUM_BITS; ++i) {
+            v.set(i);
+        }
+        return v;
+    }
 };
 
 /*
@@ -13,7 +13,8 @@
 #ifndef krypto_BridgeKey_h
 #define krypto_BridgeKey_h
 
-#include "PrivateKey.h"
+#include "DerivedKey.h"
+#include "HeapBitMatrix.h"
 #include <iostream>
 #include <ctime>
 
@@ -38,9 +39,18 @@ public:
 	_Cu1(pk.getUnaryObf1()),
 	_Cu2(pk.getUnaryObf2()),
 	_Cb1(pk.getBinaryObf1()),
-	_Cb2(pk.getBinaryObf2())
+	_Cb2(pk.getBinaryObf2()),
+	_dk(pk)
 	{}
 
+	/*
+	 * Function: getDerivedKey
+	 * Returns the inverses and splits of the private matrices shared by all the generated components
+	 */
+	const DerivedKey<N> & getDerivedKey() const{
+		return _dk;
+	}
+
 /* Unary unified code */
 
 	/*
@@ -48,7 +58,7 @@ public:
 	 * Returns the obfuscation matrix unary operations (e.g. left matrix multiplication)
 	 */
 	const BitMatrix<2*N> getPreUnaryGMatrix() const {
-		const BitMatrix<N,2*N> & matTop = _M.inv().splitV2(1);
+		const BitMatrix<N,2*N> & matTop = _dk.getMiSplit(1);
 		const BitMatrix<N,2*N> & matBot = _R * matTop;
 
 		return _Cu1 * BitMatrix<2*N>::augV(matTop, matBot);
@@ -60,7 +70,7 @@ public:
 	 */
 	const ConstantChainHeader<2*N,2*N> getUnaryG() const{
 		const SecretPolynomial<N,N,MON> & f = _pk.getf();
-		const BitMatrix<2*N> Cu1i = _Cu1.inv();
+		const BitMatrix<2*N> & Cu1i = _dk.getUnaryObf1Inv();
 
 		const SecretPolynomial<2*N,2*N,MON> & Gu = SecretPolynomial<2*N,2*N,MON>::permute(SecretPolynomial<2*N,2*N,MON>::getUnaryF(f) * Cu1i, _Cu2);
 
@@ -78,10 +88,10 @@ public:
 
 		const BitMatrix<N, 2*N> & XTop = BitMatrix<N, 2*N>::augH(T, zeroN);
 		const BitMatrix<N, 2*N> & XBot = BitMatrix<N, 2*N>::augH(zeroN, _R);
-		const BitMatrix<2*N> & X = _M * BitMatrix<2*N>::augV(XTop, XBot) * _M.inv();
+		const BitMatrix<2*N> & X = _M * BitMatrix<2*N>::augV(XTop, XBot) * _dk.getMi();
 
 		const BitMatrix<N, 2*N> & YTop = BitMatrix<N, 2*N>::augH(T, BitMatrix<N>::identityMatrix());
-		const BitMatrix<2*N> & Y = _M * BitMatrix<2*N>::augV(YTop, BitMatrix<N,2*N>::zeroMatrix()) * _Cu2.inv();
+		const BitMatrix<2*N> & Y = _M * BitMatrix<2*N>::augV(YTop, BitMatrix<N,2*N>::zeroMatrix()) * _dk.getUnaryObf2Inv();
 
 		return BitMatrix<2*N, 4*N>::augH(X, Y);
 	}
@@ -95,6 +105,16 @@ public:
 		return getLMMZ(BitMatrix<N>::leftShiftMatrix());
 	}	
 
+	/*
+	 * Function: getLeftShiftMatrix(n)
+	 * Returns a matrix used for homomorphic left shift by n
+	 */
+	const BitMatrix<2*N, 4*N> getLeftShiftMatrix(const unsigned int n) const{
+		BitMatrix<N> K = BitMatrix<N>::zeroMatrix();
+		for (unsigned int i = 0; i + n < N; ++i) K.set(i, i + n);
+		return getLMMZ(K);
+	}
+
 	/*
 	 * Function: getRightShiftMatrix
 	 * Returns a matrix RS used for homomorphic right shift
@@ -127,7 +147,7 @@ public:
 	 * Returns the obfuscation matrix for binary operations (e.g. XOR, AND)
 	 */
 	const BitMatrix<3*N,4*N> getPreBinaryGMatrix() const{
-		const BitMatrix<N,2*N> & Mi2 = _M.inv().splitV2(1);
+		const BitMatrix<N,2*N> & Mi2 = _dk.getMiSplit(1);
 
 		const BitMatrix<N,4*N> & top = BitMatrix<N,4*N>::augH(Mi2, BitMatrix<N,2*N>::zeroMatrix());
 		const BitMatrix<N,4*N> & mid = BitMatrix<N,4*N>::augH(BitMatrix<N,2*N>::zeroMatrix(), Mi2);
@@ -142,7 +162,7 @@ public:
 	 */
 	const ConstantChainHeader<3*N,3*N> getBinaryG() const{
 		const SecretPolynomial<N,N,MON> & f = _pk.getf();
-		const BitMatrix<3*N> & Cb1i = _Cb1.inv();
+		const BitMatrix<3*N> & Cb1i = _dk.getBinaryObf1Inv();
 
 		const SecretPolynomial<3*N,3*N,MON> & Gb = SecretPolynomial<3*N,3*N,MON>::permute(SecretPolynomial<3*N,3*N,MON>::getBinaryF(f) * Cb1i, _Cb2);
 
@@ -169,11 +189,6 @@ public:
 
 			return (_Xx.tMult(x)) ^ (_Xy.tMult(y)) ^ (_Y.tMult(t));
 		}
-
-		~H_XOR() {
-			// freeAllNext must be called to properly delete ConstantHeaderChain
-			_gbPoly.getMMC().freeAllNext();
-		}
 	};
 
 	const H_XOR getXOR() const{
@@ -185,13 +200,13 @@ public:
 
 /* AND */
 	struct H_AND {
-		BitMatrix<25*N*N, N> _z;
+		HeapBitMatrix<25*N*N, N> _z; //~6.5MB for N=128, kept off the stack
 		BitMatrix<2*N> _Zx, _Zy;
 		BitMatrix<4*N,2*N> _Y;
 		BitMatrix<4*N,3*N> _gbMatrix;
 		ConstantChainHeader<3*N,3*N> _gbPoly;
-		void initialize(const BitMatrix<25*N*N, N> & z, const BitMatrix<2*N> & Zx, const BitMatrix<2*N> & Zy, const BitMatrix<4*N,2*N> & Y, const BitMatrix<4*N,3*N> & gbMatrix, const ConstantChainHeader<3*N,3*N> & gbPoly){
-			_z = z;
+		void initialize(HeapBitMatrix<25*N*N, N> && z, const BitMatrix<2*N> & Zx, const BitMatrix<2*N> & Zy, const BitMatrix<4*N,2*N> & Y, const BitMatrix<4*N,3*N> & gbMatrix, const ConstantChainHeader<3*N,3*N> & gbPoly){
+			_z = std::move(z);
 			_Zx = Zx;
 			_Zy = Zy;
 			_Y = Y;
@@ -205,12 +220,7 @@ public:
 			const BitVector<5*N> & tx = BitVector<5*N>::vCat(x, t);
 			const BitVector<5*N> & ty = BitVector<5*N>::vCat(y, t);
 
-			return (_Zx.tMult(x)) ^ (_Zy.tMult(y)) ^ (_Y.tMult(BitVector<4*N>::vCat(_z.eval(tx, ty), t)));
-		}
-
-		~H_AND() {
-			// freeAllNext must be called to properly delete ConstantHeaderChain
-			_gbPoly.getMMC().freeAllNext();
+			return (_Zx.tMult(x)) ^ (_Zy.tMult(y)) ^ (_Y.tMult(BitVector<4*N>::vCat(_z->eval(tx, ty), t)));
 		}
 	};
 
@@ -231,6 +241,7 @@ private:
 	const BitMatrix<2*N> _Cu2;
 	const BitMatrix<3*N> _Cb1;
 	const BitMatrix<3*N> _Cb2;
+	const DerivedKey<N> _dk; //inverses and splits of the matrices above
 
 	/*
 	 * Function: Refresh and re-randomise Rx, Ry and all associated variables
@@ -252,7 +263,7 @@ private:
 		const BitMatrix<N, 2*N> & XTop = BitMatrix<N, 2*N>::augH(BitMatrix<N>::identityMatrix(), BitMatrix<N>::zeroMatrix());
 		const BitMatrix<N, 2*N> & XBot = BitMatrix<N, 2*N>::augH(BitMatrix<N>::zeroMatrix(), _Rx);
 
-		return _M * BitMatrix<2*N>::augV(XTop, XBot) * _M.inv();
+		return _M * BitMatrix<2*N>::augV(XTop, XBot) * _dk.getMi();
 	}
 
 	/*
@@ -263,7 +274,7 @@ private:
 		const BitMatrix<N, 2*N> XTop = BitMatrix<N, 2*N>::augH(BitMatrix<N>::identityMatrix(), BitMatrix<N>::zeroMatrix());
 		const BitMatrix<N, 2*N> XBot = BitMatrix<N, 2*N>::augH(BitMatrix<N>::zeroMatrix(), _Ry);
 
-		return _M * BitMatrix<2*N>::augV(XTop, XBot) * _M.inv();
+		return _M * BitMatrix<2*N>::augV(XTop, XBot) * _dk.getMi();
 	}
 
 	/*
@@ -274,7 +285,7 @@ private:
 		const BitMatrix<N> & idN = BitMatrix<N>::identityMatrix();
 
 		const BitMatrix<N, 3*N> & YTop = BitMatrix<N, 3*N>::augH(idN, idN, idN);
-		return _M * BitMatrix<2*N, 3*N>::augV(YTop, BitMatrix<N, 3*N>::zeroMatrix()) * _Cb2.inv();
+		return _M * BitMatrix<2*N, 3*N>::augV(YTop, BitMatrix<N, 3*N>::zeroMatrix()) * _dk.getBinaryObf2Inv();
 	}
 
 /* Helper functions for getAND */
@@ -283,12 +294,12 @@ private:
 	 * Function: getANDz
 	 * Returns function tuple z used for homomorphic AND
 	 */
-	const BitMatrix<25*N*N, N> getANDz() const{
+	HeapBitMatrix<25*N*N, N> getANDz() const{
 		unsigned int count = 0;
-		const BitMatrix<N,2*N> & Mi1 = _M.inv().splitV2(0);
-		const BitMatrix<3*N> & Cb2i = _Cb2.inv();
+		const BitMatrix<N,2*N> & Mi1 = _dk.getMiSplit(0);
+		const BitMatrix<3*N> & Cb2i = _dk.getBinaryObf2Inv();
 
-		BitMatrix<25*N*N,N> contrib = BitMatrix<25*N*N,N>::zeroMatrix();
+		HeapBitMatrix<25*N*N,N> contrib; //zero-initialized
 
 		for (int i = 0; i < 5*N; ++i)
 		{
@@ -298,7 +309,7 @@ private:
 				{
 					for (int k = 0; k < 5*N; ++k)
 					{
-						contrib.set(count + k, j, k < 2*N ? Mi1.get(j, k) : Cb2i.get(j + N, k - 2*N));
+						contrib->set(count + k, j, k < 2*N ? Mi1.get(j, k) : Cb2i.get(j + N, k - 2*N));
 					}
 				}
 			}
@@ -313,7 +324,7 @@ private:
 	 * Returns matrix Zx used for homomorphic AND
 	 */
 	const BitMatrix<2*N> getANDZx() const{
-		const BitMatrix<N, 2*N> & bottom = _Rx * _M.inv().splitV2(1);
+		const BitMatrix<N, 2*N> & bottom = _Rx * _dk.getMiSplit(1);
 		return _M * BitMatrix<2*N>::augV(BitMatrix<N, 2*N>::zeroMatrix(), bottom);
 	}
 
@@ -322,7 +333,7 @@ private:
 	 * Returns matrix Zy used for homomorphic AND
 	 */
 	const BitMatrix<2*N> getANDZy() const{
-		const BitMatrix<N, 2*N> & bottom = _Ry * _M.inv().splitV2(1);
+		const BitMatrix<N, 2*N> & bottom = _Ry * _dk.getMiSplit(1);
 		return _M * BitMatrix<2*N>::augV(BitMatrix<N, 2*N>::zeroMatrix(), bottom);
 	}
 
@@ -331,7 +342,7 @@ private:
 	 * Returns matrix Y used for homomorphic AND
 	 */
 	const BitMatrix<2*N,4*N> getANDY() const {
-		const BitMatrix<N,4*N> & top = BitMatrix<N,4*N>::augH(BitMatrix<N>::identityMatrix(), _Cb2.inv().splitV3(2));
+		const BitMatrix<N,4*N> & top = BitMatrix<N,4*N>::augH(BitMatrix<N>::identityMatrix(), _dk.getBinaryObf2InvSplit(2));
 		const BitMatrix<2*N,4*N> & inner = BitMatrix<2*N,4*N>::augV(top, BitMatrix<N,4*N>::zeroMatrix());
 
 		return _M * inner;
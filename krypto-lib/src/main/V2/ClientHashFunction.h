@@ -49,8 +49,7 @@ struct ClientHashFunction
      */
     template<unsigned int MON>
 	void generateHashMatrix(const BitMatrix<N, 2*N> & K, const PrivateKey<N,MON> & pk){
-		const BitMatrix<2*N> & Mi = pk.getM().inv();
-		const BitMatrix<N, 2*N> & Mi1 = Mi.splitV2(0);
+		const BitMatrix<N, 2*N> & Mi1 = pk.getMi().splitV2(0);
 
 		const BitMatrix<N, 2*N> & decryptMatrix = Mi1;
 
@@ -80,7 +79,7 @@ struct ClientHashFunction
 		const BitMatrix<2*N> C1i = (B * stackAi).transpose();
 		SecretPolynomial<2*N,2*N,MON> G = SecretPolynomial<2*N,2*N,MON>::permute(SecretPolynomial<2*N,2*N,MON>::getUnaryF(f) * C1i, C2);
 
-		const BitMatrix<N,2*N> & Mi2 = pk.getM().inv().splitV2(1);
+		const BitMatrix<N,2*N> & Mi2 = pk.getMi().splitV2(1);
 		concealedMatrix = C1i.inv() * BitMatrix<2*N,4*N>::augV(
 			BitMatrix<N,4*N>::augH(Mi2, BitMatrix<N,2*N>::zeroMatrix()),
 			BitMatrix<N,4*N>::augH(BitMatrix<N,2*N>::zeroMatrix(), Mi2));
@@ -101,11 +100,6 @@ struct ClientHashFunction
 		const BitVector<N> & functionalOutput = augmentedK * augmentedF(augmentedOutputF1);
 		return hashMatrixOutput ^ functionalOutput;
 	}
-
-	~ClientHashFunction() {
-		// freeAllNext must be called to properly delete ConstantHeaderChain
-		augmentedF.getMMC().freeAllNext();
-	}
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,105 @@
+//
+//  DerivedKey.h
+//  krypto
+//
+//  Copyright (c) 2016 Kryptnostic. All rights reserved.
+//
+//  Inverses and splits of the PrivateKey matrices used for key generation
+//	Computed once per PrivateKey instead of once per generated component
+//
+
+#ifndef krypto_DerivedKey_h
+#define krypto_DerivedKey_h
+
+#include "PrivateKey.h"
+
+/*
+ * Template for DerivedKey
+ * Holds M^{-1}, the inverses of the obfuscation matrices C_{u1}, C_{u2}, C_{b1}, C_{b2}
+ * and the row blocks of those inverses that BridgeKey works with
+ */
+template<unsigned int N>
+class DerivedKey {
+public:
+
+	/*
+     * Constructor: (pk)
+     * Inverts the obfuscation matrices of pk; M^{-1} is taken from pk, which already holds it
+     */
+	template<unsigned int MON>
+	explicit DerivedKey(const PrivateKey<N,MON> & pk) :
+	_Mi(pk.getMi()),
+	_Cu1i(pk.getUnaryObf1().inv()),
+	_Cu2i(pk.getUnaryObf2().inv()),
+	_Cb1i(pk.getBinaryObf1().inv()),
+	_Cb2i(pk.getBinaryObf2().inv())
+	{
+		for (unsigned int i = 0; i < 2; ++i) {
+			_MiSplit[i] = _Mi.splitV2(i);
+			_Cu1iSplit[i] = _Cu1i.splitV2(i);
+		}
+		for (unsigned int i = 0; i < 3; ++i) {
+			_Cb1iSplit[i] = _Cb1i.splitV3(i);
+			_Cb2iSplit[i] = _Cb2i.splitV3(i);
+		}
+	}
+
+/* Getters */
+
+	const BitMatrix<2*N> & getMi() const{
+		return _Mi;
+	}
+
+	//splitV2(i) of M^{-1}
+	const BitMatrix<N, 2*N> & getMiSplit(const unsigned int i) const{
+		if (DEBUG) assert(i < 2);
+		return _MiSplit[i];
+	}
+
+	const BitMatrix<2*N> & getUnaryObf1Inv() const{
+		return _Cu1i;
+	}
+
+	//splitV2(i) of C_{u1}^{-1}
+	const BitMatrix<N, 2*N> & getUnaryObf1InvSplit(const unsigned int i) const{
+		if (DEBUG) assert(i < 2);
+		return _Cu1iSplit[i];
+	}
+
+	const BitMatrix<2*N> & getUnaryObf2Inv() const{
+		return _Cu2i;
+	}
+
+	const BitMatrix<3*N> & getBinaryObf1Inv() const{
+		return _Cb1i;
+	}
+
+	//splitV3(i) of C_{b1}^{-1}
+	const BitMatrix<N, 3*N> & getBinaryObf1InvSplit(const unsigned int i) const{
+		if (DEBUG) assert(i < 3);
+		return _Cb1iSplit[i];
+	}
+
+	const BitMatrix<3*N> & getBinaryObf2Inv() const{
+		return _Cb2i;
+	}
+
+	//splitV3(i) of C_{b2}^{-1}
+	const BitMatrix<N, 3*N> & getBinaryObf2InvSplit(const unsigned int i) const{
+		if (DEBUG) assert(i < 3);
+		return _Cb2iSplit[i];
+	}
+
+private:
+	const BitMatrix<2*N> _Mi;
+	const BitMatrix<2*N> _Cu1i;
+	const BitMatrix<2*N> _Cu2i;
+	const BitMatrix<3*N> _Cb1i;
+	const BitMatrix<3*N> _Cb2i;
+	BitMatrix<N, 2*N> _MiSplit[2];
+	BitMatrix<N, 2*N> _Cu1iSplit[2];
+	BitMatrix<N, 3*N> _Cb1iSplit[3];
+	BitMatrix<N, 3*N> _Cb2iSplit[3];
+};
+
+#endif
@@ -0,0 +1,112 @@
+//
+//  HeapBitMatrix.h
+//  krypto
+//
+//  Copyright (c) 2016 Kryptnostic. All rights reserved.
+//
+//  Heap storage for BitMatrix instances too large for the stack
+//  The rows live in one aligned allocation owned by the HeapBitMatrix
+//
+
+#ifndef krypto_HeapBitMatrix_h
+#define krypto_HeapBitMatrix_h
+
+#include "BitMatrix.h"
+#include <cstdlib>
+#include <new>
+#define HEAP_MATRIX_ALIGNMENT 64 //cache line
+
+/*
+ * Template for HeapBitMatrix
+ * Owns a zero-initialized BitMatrix<ROWS,COLS> allocated on the heap
+ * Copies are deep, moves only transfer the allocation
+ * The matrix itself is reached through * and ->
+ */
+template<unsigned int ROWS, unsigned int COLS = ROWS>
+class HeapBitMatrix {
+public:
+
+/* Constructors */
+
+	/*
+     * Default constructor
+     * Allocates a zero matrix
+     */
+	HeapBitMatrix() : _matrix(allocate()) {
+		memset(_matrix, 0, sizeof(BitMatrix<ROWS,COLS>));
+	}
+
+	/*
+     * Copy constructor
+     * Allocates a copy of the matrix of rhs
+     */
+	HeapBitMatrix(const HeapBitMatrix<ROWS,COLS> & rhs) : _matrix(allocate()) {
+		memcpy(_matrix, rhs._matrix, sizeof(BitMatrix<ROWS,COLS>));
+	}
+
+	/*
+     * Move constructor
+     * Takes over the allocation of rhs, which is left empty
+     */
+	HeapBitMatrix(HeapBitMatrix<ROWS,COLS> && rhs) : _matrix(rhs._matrix) {
+		rhs._matrix = NULL;
+	}
+
+	~HeapBitMatrix() {
+		free(_matrix);
+	}
+
+/* Operators */
+
+	/*
+     * Operator: =
+     * Copies or moves rhs in depending on how the argument was constructed
+     */
+	HeapBitMatrix<ROWS,COLS> & operator=(HeapBitMatrix<ROWS,COLS> rhs) {
+		std::swap(_matrix, rhs._matrix);
+		return *this;
+	}
+
+	/*
+     * Operator: *
+     * Returns the matrix
+     */
+	BitMatrix<ROWS,COLS> & operator*() {
+		return *_matrix;
+	}
+
+	const BitMatrix<ROWS,COLS> & operator*() const {
+		return *_matrix;
+	}
+
+	/*
+     * Operator: ->
+     * Gives access to the members of the matrix
+     */
+	BitMatrix<ROWS,COLS> * operator->() {
+		return _matrix;
+	}
+
+	const BitMatrix<ROWS,COLS> * operator->() const {
+		return _matrix;
+	}
+
+	/*
+     * Function: isEmpty()
+     * Returns whether the allocation has been moved out
+     */
+	bool isEmpty() const {
+		return _matrix == NULL;
+	}
+
+private:
+	BitMatrix<ROWS,COLS> * _matrix;
+
+	static BitMatrix<ROWS,COLS> * allocate() {
+		void * memory = NULL;
+		if (posix_memalign(&memory, HEAP_MATRIX_ALIGNMENT, sizeof(BitMatrix<ROWS,COLS>)) != 0) throw std::bad_alloc();
+		return static_cast<BitMatrix<ROWS,COLS> *>(memory);
+	}
+};
+
+#endif
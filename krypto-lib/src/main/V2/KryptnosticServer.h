@@ -14,6 +14,8 @@
 #define krypto_KryptnosticServer_h
 
 #include "ClientHashFunction.h"
+#include "ThreadPool.h"
+#include "PreparedBitMatrix.h"
 
 template<unsigned int N = 128>
 class KryptnosticServer {
@@ -31,7 +33,12 @@ public:
 	KryptnosticServer(const ClientHashFunction<N> & cHashFunction, const BitVector<2*N> & eSearchToken) :
 	_hashMatrixR(cHashFunction.hashMatrix.splitH2(1)),
 	_augmentedK(cHashFunction.augmentedK),
-	_concealedMatrix(cHashFunction.concealedMatrix.splitV2(1).splitH2(1))
+	_concealedMatrix(cHashFunction.concealedMatrix.splitV2(1).splitH2(1)),
+	_keyMatrixT(BitMatrix<2*N, 2*N>::augV(_concealedMatrix, _hashMatrixR).transpose()),
+	_augmentedKt(_augmentedK.transpose()),
+	_preparedHashMatrixR(_hashMatrixR),
+	_preparedAugmentedK(_augmentedK),
+	_preparedConcealedMatrix(_concealedMatrix)
 	{
 		const BitVector<2*N> & hashMatrixPartialEval = _augmentedK.rightInverse() * (cHashFunction.hashMatrix.splitH2(0) * eSearchToken);
 		
@@ -51,19 +58,62 @@ public:
 		const BitMatrix<N> & objectConversionMatrix = objectSearchPair.second; //get from pair
 
 		// return cHashFunction(eSearchToken, eObscuredObjectSearchKey);
-		const BitVector<N> & fullEval = _augmentedK * _tokenAddressFunction(_concealedMatrix * eObjectSearchKey) ^ (_hashMatrixR * eObjectSearchKey);
+		const BitVector<N> & fullEval = _preparedAugmentedK * _tokenAddressFunction(_preparedConcealedMatrix * eObjectSearchKey) ^ (_preparedHashMatrixR * eObjectSearchKey);
 		return objectConversionMatrix * fullEval;
 	}
 
-	~KryptnosticServer() {
-		// freeAllNext must be called to properly delete ConstantHeaderChain
-		_tokenAddressFunction.getMMC().freeAllNext();
+	/*
+	 * Function: getMetadataAddresses(objectSearchPairs, addresses, count)
+	 * Computes getMetadataAddress for count object search pairs into addresses
+	 * The encrypted ObjectSearchKeys are stacked as rows of a block so _concealedMatrix,
+	 * _hashMatrixR and _augmentedK are applied with one matrix product per block each,
+	 * and _tokenAddressFunction is evaluated on the block monomial by monomial
+	 */
+	void getMetadataAddresses(const std::pair <BitVector<2*N>, BitMatrix<N> > * objectSearchPairs, BitVector<N> * addresses, const unsigned int count) const{
+		BitMatrix<BATCH_BLOCK_ROWS, 2*N> keys = BitMatrix<BATCH_BLOCK_ROWS, 2*N>::zeroMatrix();
+		BitMatrix<BATCH_BLOCK_ROWS, 2*N> tokenEvals = BitMatrix<BATCH_BLOCK_ROWS, 2*N>::zeroMatrix();
+		for (unsigned int start = 0; start < count; start += BATCH_BLOCK_ROWS) {
+			const unsigned int size = min<unsigned int>(BATCH_BLOCK_ROWS, count - start);
+			for (unsigned int j = 0; j < size; ++j) {
+				keys[j] = objectSearchPairs[start + j].first;
+			}
+			const BitMatrix<BATCH_BLOCK_ROWS, 2*N> & projected = keys * _keyMatrixT; //rows are concealed key | hashed key
+			BitVector<N> concealedKeys[BATCH_BLOCK_ROWS];
+			BitVector<N> concealed, hashed;
+			for (unsigned int j = 0; j < size; ++j) {
+				projected[j].proj(concealedKeys[j], hashed);
+			}
+			_tokenAddressFunction.evaluateBatch(concealedKeys, &tokenEvals[0], size);
+			const BitMatrix<BATCH_BLOCK_ROWS, N> & fullEvals = tokenEvals * _augmentedKt;
+			for (unsigned int j = 0; j < size; ++j) {
+				projected[j].proj(concealed, hashed);
+				addresses[start + j] = objectSearchPairs[start + j].second * (fullEvals[j] ^ hashed);
+			}
+		}
+	}
+
+	/*
+	 * Function: getMetadataAddressesParallel(objectSearchPairs, addresses, count, pool)
+	 * Computes getMetadataAddresses with the pairs partitioned in blocks over the workers of pool
+	 * Addresses are written in input order; the server is read-only after construction,
+	 * so all workers share it
+	 */
+	void getMetadataAddressesParallel(const std::pair <BitVector<2*N>, BitMatrix<N> > * objectSearchPairs, BitVector<N> * addresses, const unsigned int count, ThreadPool & pool) const{
+		const unsigned int grain = min<unsigned int>(BATCH_BLOCK_ROWS, count / (4 * pool.size()) + 1); //a few chunks per worker to balance
+		pool.parallelFor(count, grain, [&](const unsigned int start, const unsigned int size) {
+			getMetadataAddresses(objectSearchPairs + start, addresses + start, size);
+		});
 	}
 
 private:
 	const BitMatrix<N,2*N> _hashMatrixR;
 	const BitMatrix<N,2*N> _augmentedK;
 	const BitMatrix<N,2*N> _concealedMatrix;
+	const BitMatrix<2*N,2*N> _keyMatrixT; //transpose of _concealedMatrix stacked over _hashMatrixR
+	const BitMatrix<2*N,N> _augmentedKt; //transpose of _augmentedK
+	const PreparedBitMatrix<N,2*N> _preparedHashMatrixR; //column tables of the three matrices above, used per pair
+	const PreparedBitMatrix<N,2*N> _preparedAugmentedK;
+	const PreparedBitMatrix<N,2*N> _preparedConcealedMatrix;
 	ConstantChainHeader<N,2*N> _tokenAddressFunction;
 };
 
@@ -13,19 +13,55 @@
 #define krypto_MonomialMatrix_h 
 
 #include "BitMatrix.h"
+#include "HeapBitMatrix.h"
 #include <algorithm>
+#define MMC_BATCH_BLOCK 32 //inputs per block of evaluateBatch, their zero bits take NUM_INPUT words each
 
 using namespace std;
 
 /*
  * Template for MonomialMatrixChain
  * A class to represent polynomial as a chain of monomials WITHOUT CONSTANTS
+ * The monomials are stored in order in one aligned allocation owned by the chain, which always holds at least one
+ * Copies are deep, moves only transfer the allocation
  * Accessed publically 
  */
 template<unsigned int NUM_INPUT, unsigned int NUM_OUTPUT>
 class MonomialMatrixChain
 {
 public:
+/* Constructors */
+
+	/*
+	 * Default constructor
+	 * Constructs the chain of a single zero monomial, same as zero()
+	 */
+	MonomialMatrixChain() : _nodes(allocate(1)), _length(1), _capacity(1) {
+		_nodes[0] = BitMatrix<NUM_INPUT,NUM_OUTPUT>::zeroMatrix();
+	}
+
+	/*
+	 * Copy constructor
+	 * Allocates a copy of the monomials of rhs
+	 */
+	MonomialMatrixChain(const MonomialMatrixChain<NUM_INPUT,NUM_OUTPUT> & rhs) : _nodes(allocate(rhs._length)), _length(rhs._length), _capacity(rhs._length) {
+		memcpy(_nodes, rhs._nodes, _length * sizeof(BitMatrix<NUM_INPUT,NUM_OUTPUT>));
+	}
+
+	/*
+	 * Move constructor
+	 * Takes over the allocation of rhs, which is left empty
+	 */
+	MonomialMatrixChain(MonomialMatrixChain<NUM_INPUT,NUM_OUTPUT> && rhs) : _nodes(rhs._nodes), _length(rhs._length), _capacity(rhs._capacity) {
+		rhs._nodes = NULL;
+		rhs._length = 0;
+		rhs._capacity = 0;
+	}
+
+	~MonomialMatrixChain() {
+		free(_nodes);
+	}
+
 /* Generation */
 
 	/*
@@ -33,37 +69,41 @@ public:
 	 * Returns a zero-initialized MonomialMatrixChain representing zero monomial
 	 */
 	static const MonomialMatrixChain<NUM_INPUT,NUM_OUTPUT> zero() {
-		MonomialMatrixChain<NUM_INPUT,NUM_OUTPUT> result;
-		result._node = BitMatrix<NUM_INPUT,NUM_OUTPUT>::zeroMatrix();
-		result._next = NULL;
-		return result;
+		return MonomialMatrixChain<NUM_INPUT,NUM_OUTPUT>();
 	}
 
 	/*
 	 * Function: random()
 	 * Returns a random MonomialMatrixChain representing a random polynomial
+	 * Every monomial after the first is added with probability 1/2
 	 */
 	static const MonomialMatrixChain<NUM_INPUT,NUM_OUTPUT> random() {
 		MonomialMatrixChain<NUM_INPUT,NUM_OUTPUT> result;
-		result._node = BitMatrix<NUM_INPUT,NUM_OUTPUT>::randomMatrix();
-
-		unsigned int ran;
-		std::fread(&ran, sizeof( unsigned int),1,urandom);
-		if ((ran % 2) == 1)
+		result._nodes[0] = BitMatrix<NUM_INPUT,NUM_OUTPUT>::randomMatrix();
+		while ((RandomGenerator::local().nextInt() % 2) == 1)
 		{
-			result._next = new MonomialMatrixChain<NUM_INPUT,NUM_OUTPUT>;
-			*(result._next) = MonomialMatrixChain<NUM_INPUT,NUM_OUTPUT>::random();
-		} else {
-			result._next = NULL;
+			result.append(BitMatrix<NUM_INPUT,NUM_OUTPUT>::randomMatrix());
 		}
-
 		return result;
 	}
 
 /* Operators */
+
+	/*
+	 * Operator: =
+	 * Copies or moves rhs in depending on how the argument was constructed
+	 */
+	MonomialMatrixChain<NUM_INPUT,NUM_OUTPUT> & operator=(MonomialMatrixChain<NUM_INPUT,NUM_OUTPUT> rhs) {
+		std::swap(_nodes, rhs._nodes);
+		std::swap(_length, rhs._length);
+		std::swap(_capacity, rhs._capacity);
+		return *this;
+	}
+
 	/*
 	 * Operator: ()
 	 * Returns the result of evaluating the monomial matrix chain with input
+	 * The zero bits of input are listed once, then every monomial is the AND of the rows they select (see xorMonomial)
 	 */
 	const BitVector<NUM_OUTPUT> operator() (const BitVector<NUM_INPUT> & input) const {
 		// RECALL: the polynomial is a homogenous degree d polynomial
@@ -76,132 +116,115 @@ public:
 		// ... did I just do it again?
 		// ... and again...?
 		// ... why can Aquaman communicate with dolphins, aren't dolphins mammals and not fish?
-		// BitVector<NUM_OUTPUT> result = (input.isZero() ? BitVector<NUM_OUTPUT>::zeroVector() : BitVector<NUM_OUTPUT>::allOneVector());
-		BitVector<NUM_OUTPUT> result = BitVector<NUM_OUTPUT>::allOneVector();
+		unsigned int zeros[NUM_INPUT];
+		const unsigned int numZeros = zeroInputs(input, zeros);
+		BitVector<NUM_OUTPUT> result = BitVector<NUM_OUTPUT>::zeroVector();
 
-		for (int i = 0; i < NUM_INPUT; ++i)
+		for (unsigned int k = 0; k < _length; ++k)
 		{
-			if (!input.get(i)) result &= _node.getRow(i);
+			xorMonomial(_nodes[k], zeros, numZeros, result.elements());
 		}
 
-		if (_next != NULL) result ^= (*_next)(input);
-
 		return result;
 	}
 
-/* Access and Modification */
-
 	/*
-	 * Function: SetMonomialMatrix(M)
-	 * Sets the current node to be the monomial representated by BitMatrix M
+	 * Function: evaluateBatch(inputs, outputs, count)
+	 * Evaluates the monomial matrix chain on count inputs into outputs
+	 * Inputs are taken MMC_BATCH_BLOCK at a time and each monomial is applied to the whole block
+	 * before the next one, so its matrix and the zero bits of the block stay in cache
 	 */
-	void SetMonomialMatrix(const BitMatrix<NUM_INPUT,NUM_OUTPUT> & M) {
-		_node = M;
+	void evaluateBatch(const BitVector<NUM_INPUT> * inputs, BitVector<NUM_OUTPUT> * outputs, const unsigned int count) const {
+		unsigned int zeros[MMC_BATCH_BLOCK * NUM_INPUT];
+		unsigned int numZeros[MMC_BATCH_BLOCK];
+		for (unsigned int start = 0; start < count; start += MMC_BATCH_BLOCK)
+		{
+			const unsigned int size = min<unsigned int>(MMC_BATCH_BLOCK, count - start);
+			for (unsigned int j = 0; j < size; ++j)
+			{
+				numZeros[j] = zeroInputs(inputs[start + j], zeros + j * NUM_INPUT);
+				outputs[start + j].zero();
+			}
+			for (unsigned int k = 0; k < _length; ++k)
+			{
+				for (unsigned int j = 0; j < size; ++j)
+				{
+					xorMonomial(_nodes[k], zeros + j * NUM_INPUT, numZeros[j], outputs[start + j].elements());
+				}
+			}
+		}
 	}
 
 	/*
-	 * Function: SetNext(aNext)
-	 * Sets the _next pointer to aNext
+	 * Function: naiveEvaluate(input)
+	 * Same as operator() by ANDing in the rows one input bit at a time
+	 * Kept as the reference implementation for operator()
 	 */
-	void SetNext(MonomialMatrixChain<NUM_INPUT,NUM_OUTPUT> * aNext) {
-		_next = aNext;
-	}
+	const BitVector<NUM_OUTPUT> naiveEvaluate(const BitVector<NUM_INPUT> & input) const {
+		BitVector<NUM_OUTPUT> result = BitVector<NUM_OUTPUT>::zeroVector();
 
-	/*
-	 * Function: SetNext(M)
-	 * Sets the next node in the chain to be the monomial representated by BitMatrix M
-	 */
-	void SetNext(const BitMatrix<NUM_INPUT,NUM_OUTPUT> & M) {
-		_next = new MonomialMatrixChain<NUM_INPUT,NUM_OUTPUT>;
-		_next->SetMonomialMatrix(M);
-		_next->SetNext(NULL);
-	}
+		for (unsigned int k = 0; k < _length; ++k)
+		{
+			BitVector<NUM_OUTPUT> monomial = BitVector<NUM_OUTPUT>::allOneVector();
+			for (int i = 0; i < NUM_INPUT; ++i)
+			{
+				if (!input.get(i)) monomial &= _nodes[k].getRow(i);
+			}
+			result ^= monomial;
+		}
 
-	/*
-	 * Function: getMonomialMatrix()
-	 * Returns the current node
-	 */
-	const BitMatrix<NUM_INPUT,NUM_OUTPUT> getMonomialMatrix() const {
-		return _node;
+		return result;
 	}
 
-	/*
-	 * Function: getNext()
-	 * Returns the pointer to next monomials in the chain
-	 */
-	MonomialMatrixChain<NUM_INPUT,NUM_OUTPUT> * getNext() const {
-		return _next;
-	}
+/* Access and Modification */
 
 	/*
-	 * Function: getNextNode()
-	 * Returns the next node
+	 * Function: SetMonomialMatrix(M)
+	 * Sets the first monomial to be the one representated by BitMatrix M
 	 */
-	const BitMatrix<NUM_INPUT,NUM_OUTPUT> getNextNode() const {
-		return _next->getMonomialMatrix();
+	void SetMonomialMatrix(const BitMatrix<NUM_INPUT,NUM_OUTPUT> & M) {
+		_nodes[0] = M;
 	}
 
 	/*
-	 * Function: getNextMMC()
-	 * Returns the MonomialMatrixChain which represents the next monomials in the chain
-	 * (*getNext()) == getNextMMC()
+	 * Function: getMonomialMatrix(index)
+	 * Returns the monomial at a given position in the chain, the first one by default
 	 */
-	const MonomialMatrixChain<NUM_INPUT,NUM_OUTPUT> getNextMMC() const {
-		return *_next;
+	const BitMatrix<NUM_INPUT,NUM_OUTPUT> & getMonomialMatrix(const unsigned int index = 0) const {
+		if (DEBUG) assert(index < _length);
+		return _nodes[index];
 	}
 
 /* Operations on MMC */
 
 	/*
 	 * Function: append(M)
-	 * Sets the next monomial in the chain to be the one represented by M
+	 * Adds the monomial represented by M at the end of the chain
+	 * The allocation doubles when full, so appending is amortized constant time
 	 */
-	void append(BitMatrix<NUM_INPUT,NUM_OUTPUT> & M) {
-		if (_next == NULL)
-		{
-			MonomialMatrixChain<NUM_INPUT,NUM_OUTPUT> * newNode = new MonomialMatrixChain<NUM_INPUT,NUM_OUTPUT>;
-			newNode->SetMonomialMatrix(M);
-			newNode->SetNext(NULL);
-			SetNext(newNode);
-			// cout << newNode << endl;
-		} else {
-			_next->append(M);
-		}
+	void append(const BitMatrix<NUM_INPUT,NUM_OUTPUT> & M) {
+		if (_length == _capacity) reserve(2 * _capacity);
+		_nodes[_length++] = M;
 	}
 
 	/*
 	 * Function compactify()
 	 * Throws out all zero monomials and shorten the chain, if possible
+	 * For each output, a zero column is replaced by the nonzero columns of the monomials after it, which move up one place
 	 */
 	void compactify() {
-		if (_next != NULL) 
+		for (int k = (int) _length - 2; k >= 0; --k)
 		{
-			_next->compactify();
 			for (int i = 0; i < NUM_OUTPUT; ++i)
 			{
-				MonomialMatrixChain<NUM_INPUT,NUM_OUTPUT> * current = this;
-				BitMatrix<NUM_INPUT,NUM_OUTPUT> currM = _node;
-				MonomialMatrixChain<NUM_INPUT,NUM_OUTPUT> * theNext = _next;
-				if (currM.getCol(i).isZero())
+				if (_nodes[k].getCol(i).isZero())
 				{
-					while (theNext != NULL)
+					for (unsigned int current = k; current + 1 < _length; ++current)
 					{
-						BitMatrix<NUM_INPUT> nextM = theNext->getMonomialMatrix();
-						BitVector<NUM_INPUT> currCol = nextM.getCol(i);
-
-						if (!currCol.isZero())
-						{
-							currM.setCol(i, currCol);
-							current->SetMonomialMatrix(currM);
-							nextM.setCol(i, BitVector<NUM_INPUT>::zeroVector());
-							theNext->SetMonomialMatrix(nextM);
-
-							currM = nextM;
-							current = theNext;
-							theNext = theNext->getNext();
-						} else {
-							break;
-						}
+						const BitVector<NUM_INPUT> & nextCol = _nodes[current + 1].getCol(i);
+						if (nextCol.isZero()) break;
+						_nodes[current].setCol(i, nextCol);
+						_nodes[current + 1].setCol(i, BitVector<NUM_INPUT>::zeroVector());
 					}
 				}
 			}
@@ -214,22 +237,19 @@ public:
 	 * Sets the current MonomialMatrixChain to be the MonomialMatrixChain obtained by partially evaluating super with partial inputs input
 	 */
 	void subMMC(const MonomialMatrixChain<2*NUM_INPUT,NUM_OUTPUT> & super, const BitVector<NUM_INPUT> & input) {
-		// BitVector<NUM_OUTPUT> partialResult = (input.isZero() ? BitVector<NUM_OUTPUT>::zeroVector() : BitVector<NUM_OUTPUT>::allOneVector());
-		BitVector<NUM_OUTPUT> partialResult = BitVector<NUM_OUTPUT>::allOneVector();
-
-		for (int i = 0; i < NUM_INPUT; ++i)
+		_length = 0;
+		reserve(super.length());
+		for (unsigned int k = 0; k < super.length(); ++k)
 		{
-			if (!input.get(i)) partialResult &= super.getMonomialMatrix().getRow(i);
-		}
+			const BitMatrix<2*NUM_INPUT,NUM_OUTPUT> & superNode = super.getMonomialMatrix(k);
+			BitVector<NUM_OUTPUT> partialResult = BitVector<NUM_OUTPUT>::allOneVector();
 
-		_node = super.getMonomialMatrix().splitV2(1).andEachRow(partialResult);
+			for (int i = 0; i < NUM_INPUT; ++i)
+			{
+				if (!input.get(i)) partialResult &= superNode.getRow(i);
+			}
 
-		if (super.getNext() != NULL) 
-		{
-			MonomialMatrixChain<NUM_INPUT,NUM_OUTPUT> * theNext = new MonomialMatrixChain<NUM_INPUT,NUM_OUTPUT>;
-			*theNext = MonomialMatrixChain<NUM_INPUT,NUM_OUTPUT>::zero();
-			theNext->subMMC(*(super.getNext()), input);
-			_next = theNext;
+			append(superNode.splitV2(1).andEachRow(partialResult));
 		}
 	}
 
@@ -237,10 +257,8 @@ public:
 	 * Function: length()
 	 * Returns the length of the chain
 	 */
-	const unsigned int length() {
-		unsigned int res = 1;
-		if (_next != NULL) res += _next->length();
-		return res;
+	const unsigned int length() const {
+		return _length;
 	}
 
 /* Print */
@@ -249,19 +267,10 @@ public:
 	 * Function: print()
 	 * Prints all the monomials in the chain as BitMatrices
 	 */
-	void print() {
-		int n = 0;
-		BitMatrix<NUM_INPUT,NUM_OUTPUT> curr = _node;
-		cout << "Matrix " << n << ": " << endl;
-		curr.print();
-		MonomialMatrixChain<NUM_INPUT,NUM_OUTPUT> * theNext = _next;
-		
-		while (theNext != NULL) {
-			n++;
-			curr = theNext->getMonomialMatrix();
+	void print() const {
+		for (unsigned int n = 0; n < _length; ++n) {
 			cout << "Matrix " << n << ": " << endl;
-			curr.print();
-			theNext = theNext->getNext();
+			_nodes[n].print();
 		}
 	}
 
@@ -269,50 +278,97 @@ public:
 	 * Function: printLast()
 	 * Prints the last monomial in the chain
 	 */
-	void printLast() {
-		if (_next != NULL)
+	void printLast() const {
+		_nodes[_length - 1].print();
+	}
+
+	/* 
+	 * Function: deleteAllEmpty()
+	 * Deletes all zero monomials after the first one, keeping the others in order
+	 */
+	void deleteAllEmpty() {
+		unsigned int kept = 1;
+		for (unsigned int k = 1; k < _length; ++k)
 		{
-			_next->printLast();
-		} else {
-			_node.print();
+			if (_nodes[k] != BitMatrix<NUM_INPUT,NUM_OUTPUT>::zeroMatrix()) _nodes[kept++] = _nodes[k];
 		}
+		_length = kept;
 	}
 
-/* Garbage Collection */
+private:
+	static const unsigned int INPUT_WORDS = (NUM_INPUT + 63) >> 6;
+	static const unsigned int OUTPUT_WORDS = (NUM_OUTPUT + 63) >> 6;
+
+	BitMatrix<NUM_INPUT,NUM_OUTPUT> * _nodes; // the monomials, each a BitMatrix representation of a (multivariate) monomial
+	unsigned int _length; // number of monomials in the chain
+	unsigned int _capacity; // number of monomials the allocation holds
+
+	/*
+	 * Function: reserve(capacity)
+	 * Grows the allocation to hold at least capacity monomials, keeping the current ones
+	 */
+	void reserve(const unsigned int capacity) {
+		if (capacity <= _capacity) return;
+		BitMatrix<NUM_INPUT,NUM_OUTPUT> * nodes = allocate(capacity);
+		memcpy(nodes, _nodes, _length * sizeof(BitMatrix<NUM_INPUT,NUM_OUTPUT>));
+		free(_nodes);
+		_nodes = nodes;
+		_capacity = capacity;
+	}
 
 	/*
-	 * Function: freeAllNext()
-	 * Frees all the pointers which points to next monomial in chain
-	 * NOTE: In every class which contains MMC (and hence ConstantHeaderChain) as a member, the user must write the destructor of the class such that the MMC calls freeAllNext(), to prevent memory leak
+	 * Function: zeroInputs(input, zeros)
+	 * Writes the indices of the zero bits of input into zeros, scanning the complement a word at a time
+	 * Returns how many there are
 	 */
-	void freeAllNext() {
-		// cout << "called the clean up crew!!" << endl;
-		// cout << _next << endl;
-		if (_next != NULL) {
-			_next->freeAllNext();
-			delete _next;
+	static unsigned int zeroInputs(const BitVector<NUM_INPUT> & input, unsigned int * zeros) {
+		const unsigned long long * x = input.elements();
+		unsigned int numZeros = 0;
+		for (unsigned int w = 0; w < INPUT_WORDS; ++w)
+		{
+			unsigned long long bits = ~x[w];
+			if (w == INPUT_WORDS - 1 && (NUM_INPUT & 63)) bits &= (1ULL << (NUM_INPUT & 63)) - 1; //bits past NUM_INPUT are not inputs
+			while (bits != 0)
+			{
+				zeros[numZeros++] = (w << 6) + __builtin_ctzll(bits);
+				bits &= bits - 1;
+			}
 		}
+		return numZeros;
 	}
 
-	/* 
-	 * Function: deleteAllEmpty()
-	 * Deletes all zero monomials
+	/*
+	 * Function: xorMonomial(node, zeros, numZeros, result)
+	 * XORs into the words of result the AND of the rows of node selected by zeros
+	 * Rows are a few words, so the AND is an inline loop over the words of one row;
+	 * it stops as soon as the product is zero, which for dense rows takes a handful of rows
 	 */
-	void deleteAllEmpty() {
-		if (_next != NULL) 
+	static void xorMonomial(const BitMatrix<NUM_INPUT,NUM_OUTPUT> & node, const unsigned int * zeros, const unsigned int numZeros, unsigned long long * result) {
+		unsigned long long product[OUTPUT_WORDS];
+		memcpy(product, BitVector<NUM_OUTPUT>::allOneVector().elements(), sizeof(product));
+		const unsigned long long * rows = node[0].elements(); //row i starts at rows + i * OUTPUT_WORDS
+		for (unsigned int z = 0; z < numZeros; ++z)
 		{
-			_next->deleteAllEmpty();
-			if (_next->getMonomialMatrix() == BitMatrix<NUM_INPUT,NUM_OUTPUT>::zeroMatrix())
+			const unsigned long long * row = rows + zeros[z] * OUTPUT_WORDS;
+			unsigned long long any = 0;
+			for (unsigned int w = 0; w < OUTPUT_WORDS; ++w)
 			{
-				delete _next;
-				SetNext(NULL);
+				product[w] &= row[w];
+				any |= product[w];
 			}
+			if (any == 0) return;
+		}
+		for (unsigned int w = 0; w < OUTPUT_WORDS; ++w)
+		{
+			result[w] ^= product[w];
 		}
 	}
 
-private:
-	BitMatrix<NUM_INPUT,NUM_OUTPUT> _node; // the current node, which is a BitMatrix representation of a (multivariate) monomial
-	MonomialMatrixChain<NUM_INPUT,NUM_OUTPUT> * _next; // pointer to the next monomial in the chain
+	static BitMatrix<NUM_INPUT,NUM_OUTPUT> * allocate(const unsigned int capacity) {
+		void * memory = NULL;
+		if (posix_memalign(&memory, HEAP_MATRIX_ALIGNMENT, capacity * sizeof(BitMatrix<NUM_INPUT,NUM_OUTPUT>)) != 0) throw std::bad_alloc();
+		return static_cast<BitMatrix<NUM_INPUT,NUM_OUTPUT> *>(memory);
+	}
 };
 
 /*
@@ -383,6 +439,18 @@ public:
 		return _headConstant ^ _mmc(input);
 	}
 
+	/*
+	 * Function: evaluateBatch(inputs, outputs, count)
+	 * Evaluates with count inputs into outputs, monomial by monomial over the batch
+	 */
+	void evaluateBatch(const BitVector<NUM_INPUT> * inputs, BitVector<NUM_OUTPUT> * outputs, const unsigned int count) const {
+		_mmc.evaluateBatch(inputs, outputs, count);
+		for (unsigned int j = 0; j < count; ++j)
+		{
+			outputs[j] ^= _headConstant;
+		}
+	}
+
 /* Access & Modification */
 
 	/*
@@ -397,7 +465,7 @@ public:
 	 * Function: SetMMC(mmc)
 	 * Sets the nonconstant portion of the polynomial
 	 */
-	void SetMMC(const MonomialMatrixChain<NUM_INPUT,NUM_OUTPUT> mmc) {
+	void SetMMC(const MonomialMatrixChain<NUM_INPUT,NUM_OUTPUT> & mmc) {
 		_mmc = mmc;
 	}
 
@@ -413,7 +481,7 @@ public:
 	 * Function: getMMC()
 	 * Returns the nonconstant portion of the polynomial
 	 */
-	MonomialMatrixChain<NUM_INPUT,NUM_OUTPUT> getMMC() const {
+	const MonomialMatrixChain<NUM_INPUT,NUM_OUTPUT> & getMMC() const {
 		return _mmc;
 	}
 
@@ -431,7 +499,7 @@ public:
 	 * Function: length()
 	 * Returns the number of nonconstant monomials with nonzero coefficient
 	 */
-	const unsigned int length() {
+	const unsigned int length() const {
 		return _mmc.length();
 	}
 
@@ -455,16 +523,6 @@ public:
 		_mmc.print();
 	}
 
-/* Garbage Collection */
-
-	/*
-	 * WORK IN PROGRESS
-	 */
-	// ~ConstantChainHeader() {
-	// 	cout << "called" << endl;
-	// 	_mmc.freeAllNext();
-	// }
-
 private:
 	BitVector<NUM_OUTPUT> _headConstant; // constant portion
 	MonomialMatrixChain<NUM_INPUT,NUM_OUTPUT> _mmc; // nonconstant portion, i.e. monomials
@@ -0,0 +1,71 @@
+//
+//  PreparedBitMatrix.h
+//  krypto
+//
+//  Copyright (c) 2016 Kryptnostic. All rights reserved.
+//
+//  Matrix * vector for fixed matrices applied to many vectors
+//  The columns are tabulated once (Method of Four Russians) so a product is COLS/8 row XORs
+//
+
+#ifndef krypto_PreparedBitMatrix_h
+#define krypto_PreparedBitMatrix_h
+
+#include "BitMatrix.h"
+#include <vector>
+
+/*
+ * Template for PreparedBitMatrix
+ * For every chunk of 8 columns, holds the 256 sums of those columns in Gray code order
+ * A * x then XORs together the sum selected by each byte of x
+ * Tables take COLS * 32 rows of ROWS bits, so prepare matrices that are used often
+ */
+template<unsigned int ROWS, unsigned int COLS = ROWS>
+class PreparedBitMatrix {
+public:
+
+/* Constructors */
+
+	/*
+     * Constructor: (A)
+     * Builds the column tables of A
+     */
+	explicit PreparedBitMatrix(const BitMatrix<ROWS,COLS> & A) : _tables(NUM_CHUNKS * 256) {
+		const BitMatrix<COLS,ROWS> & columns = A.transpose();
+		for (unsigned int chunk = 0; chunk < NUM_CHUNKS; ++chunk) {
+			BitVector<ROWS> * table = &_tables[chunk * 256];
+			table[0].zero();
+			const unsigned int start = chunk << 3;
+			const unsigned int size = 1u << min(8u, COLS - start);
+			for (unsigned int i = 1; i < size; ++i) {
+				//gray(i) differs from gray(i - 1) in exactly the lowest set bit of i
+				table[i ^ (i >> 1)] = table[(i - 1) ^ ((i - 1) >> 1)] ^ columns[start + __builtin_ctz(i)];
+			}
+		}
+	}
+
+/* Operators */
+
+	/*
+     * Operator: *
+     * Returns the result of matrix * vector multiplication, equal to A * x
+     */
+	const BitVector<ROWS> operator*(const BitVector<COLS> & x) const {
+		BitVector<ROWS> result = BitVector<ROWS>::zeroVector();
+		const unsigned long long * words = x.elements();
+		for (unsigned int chunk = 0; chunk < NUM_CHUNKS; ++chunk) {
+			unsigned int index = (words[chunk >> 3] >> ((chunk & 7) << 3)) & 0xFF;
+			if (chunk == NUM_CHUNKS - 1) index &= LAST_CHUNK_MASK; //bits past COLS are not columns
+			if (index) result ^= _tables[chunk * 256 + index];
+		}
+		return result;
+	}
+
+private:
+	static const unsigned int NUM_CHUNKS = (COLS + 7) >> 3;
+	static const unsigned int LAST_CHUNK_MASK = (COLS & 7) ? (1u << (COLS & 7)) - 1 : 0xFF;
+
+	vector<BitVector<ROWS> > _tables; //_tables[256 * chunk + i]: sum of the columns of chunk selected by the bits of i
+};
+
+#endif
@@ -14,6 +14,7 @@
 #define krypto_PrivateKey_h
 
 #include "MonomialMatrix.h"
+#define BATCH_BLOCK_ROWS 256 //ciphertexts handled by each matrix product in the batch operations
 
 /*
  * Template for newPrivateKey
@@ -26,6 +27,7 @@ template<unsigned int N1, unsigned int M1> friend class BridgeKey;
 template<unsigned int N2> friend class ClientHashFunction;
 template<unsigned int N3> friend class SearchPrivateKey;
 template<unsigned int N4, unsigned int M4> friend class KryptnosticClient;
+template<unsigned int N5> friend class DerivedKey;
 
 public:
 
@@ -34,7 +36,8 @@ public:
      * Constructs a newPrivateKey with randomly initialized private variables
      */
 	PrivateKey():
-		_M(BitMatrix<2*N>::randomInvertibleMatrix()){
+		_M(BitMatrix<2*N>::randomInvertibleMatrix()),
+		_Mi(_M.inv()){
 		generateObfuscationPolynomials();
 	}
 
@@ -54,18 +57,66 @@ public:
      * Returns the decrypted plaintext (length N * 2^6) from a ciphertext (length 2N * 2^6)
      */
 	const BitVector<N> decrypt(const BitVector<2*N> &x) const{//returns m = D(x) given a ciphertext x
-		const BitVector<2*N> & mix = _M.solve(x);
+		const BitVector<2*N> & mix = _Mi * x;
 		BitVector<N> x1, x2;
 		mix.proj(x1, x2);
 		const BitVector<N> & fx2 = _f(x2);
 		return x1 ^ fx2;
 	}
 
+    /*
+     * Function: encryptBatch(plaintexts, ciphertexts, count)
+     * Encrypts count plaintexts into ciphertexts, which must have room for count vectors
+     * Padded plaintexts are stacked as rows of a block so _M is applied to the whole
+     * block with one matrix product instead of one mat-vec per plaintext
+     */
+	void encryptBatch(const BitVector<N> * plaintexts, BitVector<2*N> * ciphertexts, const unsigned int count) const{
+		const BitMatrix<2*N> & Mt = _M.transpose();
+		BitMatrix<BATCH_BLOCK_ROWS, 2*N> block = BitMatrix<BATCH_BLOCK_ROWS, 2*N>::zeroMatrix();
+		for (unsigned int start = 0; start < count; start += BATCH_BLOCK_ROWS) {
+			const unsigned int size = min<unsigned int>(BATCH_BLOCK_ROWS, count - start);
+			for (unsigned int j = 0; j < size; ++j) {
+				const BitVector<N> & r = BitVector<N>::randomVector();
+				block[j] = BitVector<N>::vCat(plaintexts[start + j] ^ _f(r), r);
+			}
+			const BitMatrix<BATCH_BLOCK_ROWS, 2*N> & encryptedBlock = block * Mt;
+			for (unsigned int j = 0; j < size; ++j) {
+				ciphertexts[start + j] = encryptedBlock[j];
+			}
+		}
+	}
+
+    /*
+     * Function: decryptBatch(ciphertexts, plaintexts, count)
+     * Decrypts count ciphertexts into plaintexts, which must have room for count vectors
+     * The inverse of _M is applied to a block of ciphertexts with one matrix product
+     */
+	void decryptBatch(const BitVector<2*N> * ciphertexts, BitVector<N> * plaintexts, const unsigned int count) const{
+		const BitMatrix<2*N> & Mit = _Mi.transpose();
+		BitMatrix<BATCH_BLOCK_ROWS, 2*N> block = BitMatrix<BATCH_BLOCK_ROWS, 2*N>::zeroMatrix();
+		for (unsigned int start = 0; start < count; start += BATCH_BLOCK_ROWS) {
+			const unsigned int size = min<unsigned int>(BATCH_BLOCK_ROWS, count - start);
+			for (unsigned int j = 0; j < size; ++j) {
+				block[j] = ciphertexts[start + j];
+			}
+			const BitMatrix<BATCH_BLOCK_ROWS, 2*N> & mixBlock = block * Mit;
+			BitVector<N> x1, x2;
+			for (unsigned int j = 0; j < size; ++j) {
+				mixBlock[j].proj(x1, x2);
+				plaintexts[start + j] = x1 ^ _f(x2);
+			}
+		}
+	}
+
 protected:
 	const BitMatrix<2*N> getM() const{
 		return _M;
 	}
 
+	const BitMatrix<2*N> & getMi() const{
+		return _Mi;
+	}
+
 	const SecretPolynomial<N,N,MON> getf() const{
 		return _f;
 	}
@@ -87,6 +138,7 @@ protected:
 	}
 private:
 	const BitMatrix<2*N> _M; //SL_{2n}(F_2)
+	const BitMatrix<2*N> _Mi; //inverse of _M, computed once so decryption is a single product
 	SecretPolynomial<N,N,MON> _f; //random quadratic polynomial
 	BitMatrix<2*N> _Cu[2]; //chain of obfuscation matrix for unary operations
 	BitMatrix<3*N> _Cb[2]; //chain of obfuscation matrix for binary operations
@@ -0,0 +1,169 @@
+//
+//  Random.h
+//  krypto
+//
+//  Copyright (c) 2016 Kryptnostic. All rights reserved.
+//
+//  Implementation of the random source used by every random generator
+//  ChaCha20 keystream, buffered, with one generator per thread
+//
+
+#ifndef krypto_Random_h
+#define krypto_Random_h
+
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <algorithm>
+#define RANDOM_BUFFER_BLOCKS 64 //ChaCha20 blocks (64 bytes each) generated per refill
+
+//TODO: Wrap this in a class that can release the file handle and automatically select a good source of randomness on Windows.
+//file pointer urandom must be closed by any class importing BitVector
+static FILE * urandom = std::fopen("/dev/urandom", "rb" );
+
+/*
+ * Class RandomGenerator
+ * ChaCha20 DRBG that fills RANDOM_BUFFER_BLOCKS blocks at a time
+ * Each thread gets its own generator from local(), keyed from /dev/urandom on first use
+ */
+class RandomGenerator {
+public:
+
+/* Constructors */
+
+	/*
+     * Default constructor
+     * Constructs a generator keyed from the operating system
+     */
+	RandomGenerator() {
+		reseed();
+	}
+
+	/*
+     * Function: local()
+     * Returns the generator of the calling thread
+     */
+	static RandomGenerator & local() {
+		static thread_local RandomGenerator generator;
+		return generator;
+	}
+
+/* Seeding */
+
+	/*
+     * Function: reseed()
+     * Draws a fresh key and nonce from /dev/urandom
+     * Falls back to std::random_device where /dev/urandom is unavailable
+     */
+	void reseed() {
+		unsigned int material[10];
+		if (urandom == NULL || std::fread(material, sizeof(material), 1, urandom) != 1) {
+			std::random_device device;
+			for (unsigned int i = 0; i < 10; ++i) material[i] = device();
+		}
+		seed(material, ((unsigned long long) material[9] << 32) | material[8]);
+	}
+
+	/*
+     * Function: seed(key, nonce)
+     * Restarts the keystream from a caller supplied 256-bit key and 64-bit nonce
+     */
+	void seed(const unsigned int key[8], const unsigned long long nonce) {
+		memcpy(_key, key, sizeof(_key));
+		_nonce = nonce;
+		_counter = 0;
+		_used = sizeof(_buffer);
+	}
+
+	/*
+     * Function: seed(value)
+     * Deterministic mode: restarts the keystream from a 64-bit seed
+     * Every value drawn afterwards on this thread is reproducible, for benchmarks and tests only
+     */
+	void seed(const unsigned long long value) {
+		unsigned int key[8] = {(unsigned int) value, (unsigned int) (value >> 32), 0, 0, 0, 0, 0, 0};
+		seed(key, 0);
+	}
+
+/* Generation */
+
+	/*
+     * Function: fill(out, bytes)
+     * Writes bytes random bytes to out
+     */
+	void fill(void * out, size_t bytes) {
+		unsigned char * dest = (unsigned char *) out;
+		while (bytes > 0) {
+			if (_used == sizeof(_buffer)) refill();
+			const size_t chunk = std::min(bytes, sizeof(_buffer) - _used);
+			memcpy(dest, _buffer + _used, chunk);
+			_used += chunk;
+			dest += chunk;
+			bytes -= chunk;
+		}
+	}
+
+	/*
+     * Function: nextInt()
+     * Returns a random 32-bit integer
+     */
+	unsigned int nextInt() {
+		unsigned int result;
+		fill(&result, sizeof(result));
+		return result;
+	}
+
+private:
+	unsigned int _key[8];
+	unsigned long long _nonce;
+	unsigned long long _counter; //index of the next ChaCha20 block
+	unsigned char _buffer[64 * RANDOM_BUFFER_BLOCKS];
+	size_t _used; //bytes of _buffer already handed out
+
+	static unsigned int rotate(const unsigned int x, const unsigned int n) {
+		return (x << n) | (x >> (32 - n));
+	}
+
+	static void quarterRound(unsigned int & a, unsigned int & b, unsigned int & c, unsigned int & d) {
+		a += b; d ^= a; d = rotate(d, 16);
+		c += d; b ^= c; b = rotate(b, 12);
+		a += b; d ^= a; d = rotate(d, 8);
+		c += d; b ^= c; b = rotate(b, 7);
+	}
+
+	/*
+     * Function: refill()
+     * Generates the next RANDOM_BUFFER_BLOCKS ChaCha20 blocks into _buffer
+     * State layout is the original one: 64-bit block counter in words 12-13, 64-bit nonce in words 14-15
+     */
+	void refill() {
+		for (unsigned int block = 0; block < RANDOM_BUFFER_BLOCKS; ++block, ++_counter) {
+			unsigned int state[16] = {0x61707865, 0x3320646e, 0x79622d32, 0x6b206574,
+				_key[0], _key[1], _key[2], _key[3], _key[4], _key[5], _key[6], _key[7],
+				(unsigned int) _counter, (unsigned int) (_counter >> 32), (unsigned int) _nonce, (unsigned int) (_nonce >> 32)};
+			unsigned int x[16];
+			memcpy(x, state, sizeof(x));
+			for (unsigned int round = 0; round < 10; ++round) {
+				quarterRound(x[0], x[4], x[8], x[12]);
+				quarterRound(x[1], x[5], x[9], x[13]);
+				quarterRound(x[2], x[6], x[10], x[14]);
+				quarterRound(x[3], x[7], x[11], x[15]);
+				quarterRound(x[0], x[5], x[10], x[15]);
+				quarterRound(x[1], x[6], x[11], x[12]);
+				quarterRound(x[2], x[7], x[8], x[13]);
+				quarterRound(x[3], x[4], x[9], x[14]);
+			}
+			unsigned char * out = _buffer + 64 * block;
+			for (unsigned int i = 0; i < 16; ++i) {
+				const unsigned int word = x[i] + state[i];
+				out[4 * i] = word;
+				out[4 * i + 1] = word >> 8;
+				out[4 * i + 2] = word >> 16;
+				out[4 * i + 3] = word >> 24;
+			}
+		}
+		_used = 0;
+	}
+};
+
+#endif
@@ -30,7 +30,9 @@ class SearchPrivateKey{
 public:
   SearchPrivateKey() :
   _K(BitMatrix<N>::randomInvertibleMatrix()),
-  _R(BitMatrix<N>::randomInvertibleMatrix())
+  _R(BitMatrix<N>::randomInvertibleMatrix()),
+  _Ki(_K.inv()),
+  _Ri(_R.inv())
   {}
 
   /* Getters */
@@ -67,7 +69,7 @@ public:
    * Equation: L_{doc} * K_{user}^{-1}
    */
   const BitMatrix<N> getObjectConversionMatrix(const BitMatrix<N> & objectAddressMatrix) const {
-    return objectAddressMatrix * _K.inv();
+    return objectAddressMatrix * _Ki;
   }
 
   /*
@@ -139,12 +141,14 @@ public:
    */
   template<unsigned int MON>
   const std::pair<BitVector<2*N>, BitMatrix<N>> getObjectSearchPairFromObjectSharePair(const std::pair<BitVector<N>, BitMatrix<N>> & objectSharePair, const PrivateKey<N,MON> & pk) const {
-    return std::make_pair(pk.encrypt(_R.solve(objectSharePair.first)), getObjectConversionMatrix(objectSharePair.second));
+    return std::make_pair(pk.encrypt(_Ri * objectSharePair.first), getObjectConversionMatrix(objectSharePair.second));
   }
 
 private:
   BitMatrix<N> _K; // user-specific front protection
   BitMatrix<N> _R; // user-specific hash auxiliary matrix
+  BitMatrix<N> _Ki; // inverse of _K, kept so converting an object is a single product
+  BitMatrix<N> _Ri; // inverse of _R, kept so receiving a share is a single mat-vec
 };
 
 #endif/* defined(__krypto__SearchPrivateKey__) */
\ No newline at end of file
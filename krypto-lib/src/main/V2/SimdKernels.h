@@ -0,0 +1,347 @@
+//
+//  SimdKernels.h
+//  krypto
+//
+//  Copyright (c) 2016 Kryptnostic. All rights reserved.
+//
+//  Word-array kernels behind BitVector and BitMatrix, with SSE2, AVX2 and
+//  AVX-512 (VPOPCNTDQ) implementations selected once per process by CPU detection
+//  Every version is compiled into the same binary, so no -march flag is needed
+//
+
+#ifndef krypto_SimdKernels_h
+#define krypto_SimdKernels_h
+
+#include <cstddef>
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define KRYPTO_X86_SIMD 1
+#include <immintrin.h>
+#endif
+#define SIMD_MIN_WORDS 8 //shorter arrays stay on inline loops, cheaper than an indirect call
+
+enum SimdLevel { SIMD_PORTABLE, SIMD_SSE2, SIMD_AVX2, SIMD_AVX512 };
+
+/*
+ * Struct SimdKernels
+ * Dispatch table of kernels on arrays of n 64-bit words
+ * get() returns the table for the widest vector unit of the host
+ */
+struct SimdKernels {
+	SimdLevel level;
+	void (*xorWords)(unsigned long long * dst, const unsigned long long * a, const unsigned long long * b, const size_t n); //dst = a ^ b
+	void (*andWords)(unsigned long long * dst, const unsigned long long * a, const unsigned long long * b, const size_t n); //dst = a & b
+	void (*xorInto)(unsigned long long * dst, const unsigned long long * src, const size_t n); //dst ^= src, row accumulation
+	bool (*parity)(const unsigned long long * a, const size_t n);
+	bool (*andParity)(const unsigned long long * a, const unsigned long long * b, const size_t n); //parity(a & b), the F2 dot product
+	bool (*isZero)(const unsigned long long * a, const size_t n);
+	size_t (*popcount)(const unsigned long long * a, const size_t n);
+
+	/*
+	 * Function: get()
+	 * Returns the kernels of the widest supported level, detected on first use
+	 */
+	static const SimdKernels & get() {
+		static const SimdKernels & kernels = forLevel(bestLevel());
+		return kernels;
+	}
+
+	/*
+	 * Function: supported(level)
+	 * Returns whether the host can run the kernels of a given level
+	 */
+	static bool supported(const SimdLevel level) {
+#ifdef KRYPTO_X86_SIMD
+		__builtin_cpu_init();
+		switch (level) {
+			case SIMD_PORTABLE: return true;
+			case SIMD_SSE2: return __builtin_cpu_supports("sse2");
+			case SIMD_AVX2: return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt");
+			case SIMD_AVX512: return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vpopcntdq");
+		}
+		return false;
+#else
+		return level == SIMD_PORTABLE;
+#endif
+	}
+
+	/*
+	 * Function: forLevel(level)
+	 * Returns the kernels of a given level, which the caller must have checked is supported
+	 */
+	static const SimdKernels & forLevel(const SimdLevel level) {
+		static const SimdKernels portable = {SIMD_PORTABLE, xorWordsPortable, andWordsPortable, xorIntoPortable, parityPortable, andParityPortable, isZeroPortable, popcountPortable};
+#ifdef KRYPTO_X86_SIMD
+		static const SimdKernels sse2 = {SIMD_SSE2, xorWordsSSE2, andWordsSSE2, xorIntoSSE2, paritySSE2, andParitySSE2, isZeroSSE2, popcountPortable};
+		static const SimdKernels avx2 = {SIMD_AVX2, xorWordsAVX2, andWordsAVX2, xorIntoAVX2, parityAVX2, andParityAVX2, isZeroAVX2, popcountAVX2};
+		static const SimdKernels avx512 = {SIMD_AVX512, xorWordsAVX512, andWordsAVX512, xorIntoAVX512, parityAVX512, andParityAVX512, isZeroAVX512, popcountAVX512};
+		switch (level) {
+			case SIMD_SSE2: return sse2;
+			case SIMD_AVX2: return avx2;
+			case SIMD_AVX512: return avx512;
+			default: break;
+		}
+#endif
+		return portable;
+	}
+
+private:
+	static SimdLevel bestLevel() {
+		if (supported(SIMD_AVX512)) return SIMD_AVX512;
+		if (supported(SIMD_AVX2)) return SIMD_AVX2;
+		if (supported(SIMD_SSE2)) return SIMD_SSE2;
+		return SIMD_PORTABLE;
+	}
+
+/* Portable */
+
+	static void xorWordsPortable(unsigned long long * dst, const unsigned long long * a, const unsigned long long * b, const size_t n) {
+		for (size_t i = 0; i < n; ++i) dst[i] = a[i] ^ b[i];
+	}
+
+	static void andWordsPortable(unsigned long long * dst, const unsigned long long * a, const unsigned long long * b, const size_t n) {
+		for (size_t i = 0; i < n; ++i) dst[i] = a[i] & b[i];
+	}
+
+	static void xorIntoPortable(unsigned long long * dst, const unsigned long long * src, const size_t n) {
+		for (size_t i = 0; i < n; ++i) dst[i] ^= src[i];
+	}
+
+	static bool parityPortable(const unsigned long long * a, const size_t n) {
+		unsigned long long accumulator = 0;
+		for (size_t i = 0; i < n; ++i) accumulator ^= a[i];
+		return __builtin_parityll(accumulator);
+	}
+
+	static bool andParityPortable(const unsigned long long * a, const unsigned long long * b, const size_t n) {
+		unsigned long long accumulator = 0;
+		for (size_t i = 0; i < n; ++i) accumulator ^= a[i] & b[i];
+		return __builtin_parityll(accumulator);
+	}
+
+	static bool isZeroPortable(const unsigned long long * a, const size_t n) {
+		unsigned long long accumulator = 0;
+		for (size_t i = 0; i < n; ++i) accumulator |= a[i];
+		return accumulator == 0;
+	}
+
+	static size_t popcountPortable(const unsigned long long * a, const size_t n) {
+		size_t count = 0;
+		for (size_t i = 0; i < n; ++i) count += __builtin_popcountll(a[i]);
+		return count;
+	}
+
+#ifdef KRYPTO_X86_SIMD
+
+/* SSE2, 2 words per register */
+
+	__attribute__((target("sse2")))
+	static void xorWordsSSE2(unsigned long long * dst, const unsigned long long * a, const unsigned long long * b, const size_t n) {
+		size_t i = 0;
+		for (; i + 2 <= n; i += 2) {
+			_mm_storeu_si128((__m128i *) (dst + i), _mm_xor_si128(_mm_loadu_si128((const __m128i *) (a + i)), _mm_loadu_si128((const __m128i *) (b + i))));
+		}
+		for (; i < n; ++i) dst[i] = a[i] ^ b[i];
+	}
+
+	__attribute__((target("sse2")))
+	static void andWordsSSE2(unsigned long long * dst, const unsigned long long * a, const unsigned long long * b, const size_t n) {
+		size_t i = 0;
+		for (; i + 2 <= n; i += 2) {
+			_mm_storeu_si128((__m128i *) (dst + i), _mm_and_si128(_mm_loadu_si128((const __m128i *) (a + i)), _mm_loadu_si128((const __m128i *) (b + i))));
+		}
+		for (; i < n; ++i) dst[i] = a[i] & b[i];
+	}
+
+	__attribute__((target("sse2")))
+	static void xorIntoSSE2(unsigned long long * dst, const unsigned long long * src, const size_t n) {
+		xorWordsSSE2(dst, dst, src, n);
+	}
+
+	__attribute__((target("sse2")))
+	static bool andParitySSE2(const unsigned long long * a, const unsigned long long * b, const size_t n) {
+		__m128i accumulator = _mm_setzero_si128();
+		size_t i = 0;
+		for (; i + 2 <= n; i += 2) {
+			accumulator = _mm_xor_si128(accumulator, _mm_and_si128(_mm_loadu_si128((const __m128i *) (a + i)), _mm_loadu_si128((const __m128i *) (b + i))));
+		}
+		unsigned long long words[2];
+		_mm_storeu_si128((__m128i *) words, accumulator);
+		unsigned long long folded = words[0] ^ words[1];
+		for (; i < n; ++i) folded ^= a[i] & b[i];
+		return __builtin_parityll(folded);
+	}
+
+	__attribute__((target("sse2")))
+	static bool paritySSE2(const unsigned long long * a, const size_t n) {
+		__m128i accumulator = _mm_setzero_si128();
+		size_t i = 0;
+		for (; i + 2 <= n; i += 2) {
+			accumulator = _mm_xor_si128(accumulator, _mm_loadu_si128((const __m128i *) (a + i)));
+		}
+		unsigned long long words[2];
+		_mm_storeu_si128((__m128i *) words, accumulator);
+		unsigned long long folded = words[0] ^ words[1];
+		for (; i < n; ++i) folded ^= a[i];
+		return __builtin_parityll(folded);
+	}
+
+	__attribute__((target("sse2")))
+	static bool isZeroSSE2(const unsigned long long * a, const size_t n) {
+		__m128i accumulator = _mm_setzero_si128();
+		size_t i = 0;
+		for (; i + 2 <= n; i += 2) {
+			accumulator = _mm_or_si128(accumulator, _mm_loadu_si128((const __m128i *) (a + i)));
+		}
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(accumulator, _mm_setzero_si128())) != 0xFFFF) return false;
+		for (; i < n; ++i) if (a[i] != 0) return false;
+		return true;
+	}
+
+/* AVX2, 4 words per register */
+
+	__attribute__((target("avx2")))
+	static void xorWordsAVX2(unsigned long long * dst, const unsigned long long * a, const unsigned long long * b, const size_t n) {
+		size_t i = 0;
+		for (; i + 4 <= n; i += 4) {
+			_mm256_storeu_si256((__m256i *) (dst + i), _mm256_xor_si256(_mm256_loadu_si256((const __m256i *) (a + i)), _mm256_loadu_si256((const __m256i *) (b + i))));
+		}
+		for (; i < n; ++i) dst[i] = a[i] ^ b[i];
+	}
+
+	__attribute__((target("avx2")))
+	static void andWordsAVX2(unsigned long long * dst, const unsigned long long * a, const unsigned long long * b, const size_t n) {
+		size_t i = 0;
+		for (; i + 4 <= n; i += 4) {
+			_mm256_storeu_si256((__m256i *) (dst + i), _mm256_and_si256(_mm256_loadu_si256((const __m256i *) (a + i)), _mm256_loadu_si256((const __m256i *) (b + i))));
+		}
+		for (; i < n; ++i) dst[i] = a[i] & b[i];
+	}
+
+	__attribute__((target("avx2")))
+	static void xorIntoAVX2(unsigned long long * dst, const unsigned long long * src, const size_t n) {
+		xorWordsAVX2(dst, dst, src, n);
+	}
+
+	__attribute__((target("avx2")))
+	static unsigned long long foldAVX2(const __m256i v) {
+		const __m128i half = _mm_xor_si128(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+		return (unsigned long long) _mm_cvtsi128_si64(half) ^ (unsigned long long) _mm_cvtsi128_si64(_mm_unpackhi_epi64(half, half));
+	}
+
+	__attribute__((target("avx2")))
+	static bool andParityAVX2(const unsigned long long * a, const unsigned long long * b, const size_t n) {
+		__m256i accumulator = _mm256_setzero_si256();
+		size_t i = 0;
+		for (; i + 4 <= n; i += 4) {
+			accumulator = _mm256_xor_si256(accumulator, _mm256_and_si256(_mm256_loadu_si256((const __m256i *) (a + i)), _mm256_loadu_si256((const __m256i *) (b + i))));
+		}
+		unsigned long long folded = foldAVX2(accumulator);
+		for (; i < n; ++i) folded ^= a[i] & b[i];
+		return __builtin_parityll(folded);
+	}
+
+	__attribute__((target("avx2")))
+	static bool parityAVX2(const unsigned long long * a, const size_t n) {
+		__m256i accumulator = _mm256_setzero_si256();
+		size_t i = 0;
+		for (; i + 4 <= n; i += 4) {
+			accumulator = _mm256_xor_si256(accumulator, _mm256_loadu_si256((const __m256i *) (a + i)));
+		}
+		unsigned long long folded = foldAVX2(accumulator);
+		for (; i < n; ++i) folded ^= a[i];
+		return __builtin_parityll(folded);
+	}
+
+	__attribute__((target("avx2")))
+	static bool isZeroAVX2(const unsigned long long * a, const size_t n) {
+		__m256i accumulator = _mm256_setzero_si256();
+		size_t i = 0;
+		for (; i + 4 <= n; i += 4) {
+			accumulator = _mm256_or_si256(accumulator, _mm256_loadu_si256((const __m256i *) (a + i)));
+		}
+		if (!_mm256_testz_si256(accumulator, accumulator)) return false;
+		for (; i < n; ++i) if (a[i] != 0) return false;
+		return true;
+	}
+
+	__attribute__((target("avx2,popcnt")))
+	static size_t popcountAVX2(const unsigned long long * a, const size_t n) {
+		size_t count = 0;
+		for (size_t i = 0; i < n; ++i) count += __builtin_popcountll(a[i]);
+		return count;
+	}
+
+/* AVX-512, 8 words per register; the tail is handled with masked loads */
+
+	__attribute__((target("avx512f")))
+	static void xorWordsAVX512(unsigned long long * dst, const unsigned long long * a, const unsigned long long * b, const size_t n) {
+		for (size_t i = 0; i < n; i += 8) {
+			const __mmask8 mask = n - i >= 8 ? 0xFF : (__mmask8) ((1u << (n - i)) - 1);
+			_mm512_mask_storeu_epi64(dst + i, mask, _mm512_xor_si512(_mm512_maskz_loadu_epi64(mask, a + i), _mm512_maskz_loadu_epi64(mask, b + i)));
+		}
+	}
+
+	__attribute__((target("avx512f")))
+	static void andWordsAVX512(unsigned long long * dst, const unsigned long long * a, const unsigned long long * b, const size_t n) {
+		for (size_t i = 0; i < n; i += 8) {
+			const __mmask8 mask = n - i >= 8 ? 0xFF : (__mmask8) ((1u << (n - i)) - 1);
+			_mm512_mask_storeu_epi64(dst + i, mask, _mm512_and_si512(_mm512_maskz_loadu_epi64(mask, a + i), _mm512_maskz_loadu_epi64(mask, b + i)));
+		}
+	}
+
+	__attribute__((target("avx512f")))
+	static void xorIntoAVX512(unsigned long long * dst, const unsigned long long * src, const size_t n) {
+		xorWordsAVX512(dst, dst, src, n);
+	}
+
+	__attribute__((target("avx512f")))
+	static bool andParityAVX512(const unsigned long long * a, const unsigned long long * b, const size_t n) {
+		__m512i accumulator = _mm512_setzero_si512();
+		for (size_t i = 0; i < n; i += 8) {
+			const __mmask8 mask = n - i >= 8 ? 0xFF : (__mmask8) ((1u << (n - i)) - 1);
+			accumulator = _mm512_xor_si512(accumulator, _mm512_and_si512(_mm512_maskz_loadu_epi64(mask, a + i), _mm512_maskz_loadu_epi64(mask, b + i)));
+		}
+		return __builtin_parityll(xorReduceAVX512(accumulator));
+	}
+
+	__attribute__((target("avx512f")))
+	static bool parityAVX512(const unsigned long long * a, const size_t n) {
+		__m512i accumulator = _mm512_setzero_si512();
+		for (size_t i = 0; i < n; i += 8) {
+			const __mmask8 mask = n - i >= 8 ? 0xFF : (__mmask8) ((1u << (n - i)) - 1);
+			accumulator = _mm512_xor_si512(accumulator, _mm512_maskz_loadu_epi64(mask, a + i));
+		}
+		return __builtin_parityll(xorReduceAVX512(accumulator));
+	}
+
+	__attribute__((target("avx512f")))
+	static unsigned long long xorReduceAVX512(const __m512i v) {
+		unsigned long long words[8];
+		_mm512_storeu_si512(words, v);
+		return words[0] ^ words[1] ^ words[2] ^ words[3] ^ words[4] ^ words[5] ^ words[6] ^ words[7];
+	}
+
+	__attribute__((target("avx512f")))
+	static bool isZeroAVX512(const unsigned long long * a, const size_t n) {
+		__m512i accumulator = _mm512_setzero_si512();
+		for (size_t i = 0; i < n; i += 8) {
+			const __mmask8 mask = n - i >= 8 ? 0xFF : (__mmask8) ((1u << (n - i)) - 1);
+			accumulator = _mm512_or_si512(accumulator, _mm512_maskz_loadu_epi64(mask, a + i));
+		}
+		return _mm512_test_epi64_mask(accumulator, accumulator) == 0;
+	}
+
+	__attribute__((target("avx512f,avx512vpopcntdq")))
+	static size_t popcountAVX512(const unsigned long long * a, const size_t n) {
+		__m512i counts = _mm512_setzero_si512();
+		for (size_t i = 0; i < n; i += 8) {
+			const __mmask8 mask = n - i >= 8 ? 0xFF : (__mmask8) ((1u << (n - i)) - 1);
+			counts = _mm512_add_epi64(counts, _mm512_popcnt_epi64(_mm512_maskz_loadu_epi64(mask, a + i)));
+		}
+		return _mm512_reduce_add_epi64(counts);
+	}
+
+#endif
+};
+
+#endif
@@ -0,0 +1,173 @@
+//
+//  ThreadPool.h
+//  krypto
+//
+//  Copyright (c) 2016 Kryptnostic. All rights reserved.
+//
+//  Implementation of a fixed-size work-stealing thread pool
+//  Each worker owns a task deque; idle workers steal from the others
+//
+
+#ifndef krypto_ThreadPool_h
+#define krypto_ThreadPool_h
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <algorithm>
+
+class ThreadPool {
+public:
+
+/* Constructors */
+
+	/*
+     * Constructor: (numThreads)
+     * Starts numThreads workers, one per hardware thread by default
+     */
+	explicit ThreadPool(unsigned int numThreads = std::thread::hardware_concurrency()) :
+	_next(0),
+	_queued(0),
+	_stop(false)
+	{
+		if (numThreads == 0) numThreads = 1;
+		for (unsigned int i = 0; i < numThreads; ++i) {
+			_queues.push_back(std::unique_ptr<WorkQueue>(new WorkQueue()));
+		}
+		for (unsigned int i = 0; i < numThreads; ++i) {
+			_workers.push_back(std::thread(&ThreadPool::run, this, i));
+		}
+	}
+
+	/*
+     * Destructor
+     * Lets the workers finish every queued task, then joins them
+     */
+	~ThreadPool() {
+		{
+			std::lock_guard<std::mutex> guard(_lock);
+			_stop = true;
+		}
+		_wake.notify_all();
+		for (unsigned int i = 0; i < _workers.size(); ++i) {
+			_workers[i].join();
+		}
+	}
+
+/* Scheduling */
+
+	/*
+     * Function: size()
+     * Returns the number of workers
+     */
+	unsigned int size() const {
+		return _workers.size();
+	}
+
+	/*
+     * Function: submit(task)
+     * Queues a task on the next worker in round-robin order
+     * Tasks must not throw
+     */
+	void submit(const std::function<void()> & task) {
+		{
+			std::lock_guard<std::mutex> guard(_lock);
+			++_queued;
+		}
+		WorkQueue & queue = *_queues[_next++ % _queues.size()];
+		{
+			std::lock_guard<std::mutex> guard(queue.lock);
+			queue.tasks.push_back(task);
+		}
+		_wake.notify_one();
+	}
+
+	/*
+     * Function: parallelFor(count, grain, body)
+     * Splits [0, count) into chunks of at most grain indices, runs body(start, size)
+     * on each chunk across the workers and returns once every chunk is done
+     * Must not be called from inside a task of the same pool
+     */
+	template <typename Function>
+	void parallelFor(const unsigned int count, const unsigned int grain, Function body) {
+		if (count == 0) return;
+		const unsigned int step = grain ? grain : 1;
+		std::mutex doneLock;
+		std::condition_variable done;
+		unsigned int remaining = (count + step - 1) / step;
+		for (unsigned int start = 0; start < count; start += step) {
+			const unsigned int size = std::min(step, count - start);
+			submit([&, start, size]() {
+				body(start, size);
+				std::lock_guard<std::mutex> guard(doneLock);
+				if (--remaining == 0) done.notify_one();
+			});
+		}
+		std::unique_lock<std::mutex> guard(doneLock);
+		done.wait(guard, [&]() { return remaining == 0; });
+	}
+
+private:
+	struct WorkQueue {
+		std::mutex lock;
+		std::deque<std::function<void()> > tasks;
+	};
+
+	std::vector<std::unique_ptr<WorkQueue> > _queues; //one deque per worker
+	std::vector<std::thread> _workers;
+	std::atomic<unsigned int> _next; //round-robin cursor for submit
+	std::mutex _lock; //guards _queued and _stop
+	std::condition_variable _wake;
+	unsigned int _queued; //tasks submitted but not yet taken by a worker
+	bool _stop;
+
+	/*
+     * Function: takeTask(self, task)
+     * Pops the newest task of worker self, or steals the oldest task of another worker
+     * Returns whether a task was found
+     */
+	bool takeTask(const unsigned int self, std::function<void()> & task) {
+		for (unsigned int k = 0; k < _queues.size(); ++k) {
+			WorkQueue & queue = *_queues[(self + k) % _queues.size()];
+			std::lock_guard<std::mutex> guard(queue.lock);
+			if (queue.tasks.empty()) continue;
+			if (k == 0) {
+				task = queue.tasks.back();
+				queue.tasks.pop_back();
+			} else {
+				task = queue.tasks.front();
+				queue.tasks.pop_front();
+			}
+			return true;
+		}
+		return false;
+	}
+
+	/*
+     * Function: run(self)
+     * Worker loop: runs tasks until the pool is stopped and nothing is left queued
+     */
+	void run(const unsigned int self) {
+		std::function<void()> task;
+		while (true) {
+			if (takeTask(self, task)) {
+				{
+					std::lock_guard<std::mutex> guard(_lock);
+					--_queued;
+				}
+				task();
+				continue;
+			}
+			std::unique_lock<std::mutex> guard(_lock);
+			_wake.wait(guard, [this]() { return _stop || _queued > 0; });
+			if (_stop && _queued == 0) return;
+		}
+	}
+};
+
+#endif
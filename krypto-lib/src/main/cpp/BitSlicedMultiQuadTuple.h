@@ -0,0 +1,192 @@
+//
+//  BitSlicedMultiQuadTuple.h
+//  krypto
+//
+//  Copyright (c) 2016 Kryptnostic. All rights reserved.
+//
+//  Bit-sliced evaluation of a MultiQuadTuple on SLICE_LANES inputs at once
+//  Bit k of slice i is bit i of input k, so every word operation acts on many inputs
+//
+
+#ifndef krypto_BitSlicedMultiQuadTuple_h
+#define krypto_BitSlicedMultiQuadTuple_h
+
+#include "FlatMultiQuadTuple.h"
+#include <vector>
+#define SLICE_WORDS 4 //64-bit words per slice, one 256-bit AVX2 register
+#define SLICE_LANES (64 * SLICE_WORDS) //inputs evaluated together
+#define SLICE_BATCH_MIN 128 //below this many inputs, evaluating them one at a time is faster
+
+/*
+ * Struct BitSlice
+ * One bit position of SLICE_LANES vectors, lane k in bit k & 63 of word k >> 6
+ */
+struct BitSlice {
+    unsigned long long words[SLICE_WORDS];
+
+    void zero() {
+        for (unsigned int q = 0; q < SLICE_WORDS; ++q) words[q] = 0;
+    }
+
+    void fill(const bool value) {
+        for (unsigned int q = 0; q < SLICE_WORDS; ++q) words[q] = value ? ~0ULL : 0;
+    }
+
+    void operator^=(const BitSlice & rhs) {
+        for (unsigned int q = 0; q < SLICE_WORDS; ++q) words[q] ^= rhs.words[q];
+    }
+
+    const BitSlice operator^(const BitSlice & rhs) const {
+        BitSlice result;
+        for (unsigned int q = 0; q < SLICE_WORDS; ++q) result.words[q] = words[q] ^ rhs.words[q];
+        return result;
+    }
+
+    const BitSlice operator&(const BitSlice & rhs) const {
+        BitSlice result;
+        for (unsigned int q = 0; q < SLICE_WORDS; ++q) result.words[q] = words[q] & rhs.words[q];
+        return result;
+    }
+};
+
+/*
+ * Template for BitSlicedMultiQuadTuple
+ * Output bit o is the parity of the monomial slices x_i & x_j whose coefficient for o is set.
+ * Monomials are taken 8 at a time (in the order of FlatMultiQuadTuple): the 256 XOR
+ * combinations of their slices are tabulated once and each output looks up its
+ * combination by an 8-bit index, so a monomial costs about 32 + NUM_OUTPUTS/8 slice
+ * operations for all SLICE_LANES inputs together
+ */
+template<unsigned int NUM_INPUTS, unsigned int NUM_OUTPUTS>
+class BitSlicedMultiQuadTuple {
+public:
+
+/* Constructors */
+
+    /*
+     * Default constructor
+     * Constructs the zero function
+     */
+    BitSlicedMultiQuadTuple() :
+    _indices(NUM_GROUPS * NUM_OUTPUTS, 0),
+    _constants(BitVector<NUM_OUTPUTS>::zeroVector())
+    {
+    }
+
+    /*
+     * Constructor: (f)
+     * Transposes the coefficients of f into per-output indices of 8 monomials
+     */
+    explicit BitSlicedMultiQuadTuple(const FlatMultiQuadTuple<NUM_INPUTS, NUM_OUTPUTS> & f) :
+    _indices(NUM_GROUPS * NUM_OUTPUTS, 0),
+    _constants(f.getConstants())
+    {
+        for (unsigned int m = 0; m < NUM_INPUT_MONOMIALS; ++m) {
+            unsigned char * indices = &_indices[(m >> 3) * NUM_OUTPUTS];
+            const unsigned char bit = 1 << (m & 7);
+            const unsigned long long * row = f[m].elements();
+            for (unsigned int w = 0; w < OUTPUT_WORDS; ++w) {
+                unsigned long long bits = row[w];
+                while (bits != 0) {
+                    const unsigned int o = (w << 6) + __builtin_ctzll(bits);
+                    bits &= bits - 1;
+                    if (o < NUM_OUTPUTS) indices[o] |= bit;
+                }
+            }
+        }
+    }
+
+    explicit BitSlicedMultiQuadTuple(const MultiQuadTuple<NUM_INPUTS, NUM_OUTPUTS> & f) :
+    BitSlicedMultiQuadTuple(FlatMultiQuadTuple<NUM_INPUTS, NUM_OUTPUTS>(f))
+    {
+    }
+
+/* Evaluation */
+
+    /*
+     * Function: evaluateSlices(inputs, outputs)
+     * Evaluates on SLICE_LANES inputs given as NUM_INPUTS slices
+     * Writes NUM_OUTPUTS slices, lane k of which is the value at input k
+     */
+    void evaluateSlices(const BitSlice * inputs, BitSlice * outputs) const {
+        for (unsigned int o = 0; o < NUM_OUTPUTS; ++o) {
+            outputs[o].fill(_constants.get(o));
+        }
+        BitSlice products[8];
+        BitSlice table[256];
+        table[0].zero();
+        unsigned int i = 0, j = 0; //next monomial x_i x_j
+        for (unsigned int g = 0; g < NUM_GROUPS; ++g) {
+            for (unsigned int b = 0; b < 8; ++b) {
+                if (i < NUM_INPUTS) {
+                    products[b] = inputs[i] & inputs[j];
+                    if (++j == NUM_INPUTS) j = ++i;
+                } else {
+                    products[b].zero(); //past the last monomial
+                }
+            }
+            for (unsigned int b = 0; b < 8; ++b) {
+                const unsigned int half = 1 << b;
+                for (unsigned int t = 0; t < half; ++t) {
+                    table[half + t] = table[t] ^ products[b];
+                }
+            }
+            const unsigned char * indices = &_indices[g * NUM_OUTPUTS];
+            for (unsigned int o = 0; o < NUM_OUTPUTS; ++o) {
+                outputs[o] ^= table[indices[o]];
+            }
+        }
+    }
+
+    /*
+     * Function: evaluateBatch(inputs, outputs, count)
+     * Evaluates on count input vectors, transposing them SLICE_LANES at a time
+     * Worth it from about SLICE_BATCH_MIN inputs; unused lanes of the last block are zero
+     */
+    void evaluateBatch(const BitVector<NUM_INPUTS> * inputs, BitVector<NUM_OUTPUTS> * outputs, const unsigned int count) const {
+        BitSlice inputSlices[NUM_INPUTS];
+        BitSlice outputSlices[NUM_OUTPUTS];
+        for (unsigned int start = 0; start < count; start += SLICE_LANES) {
+            const unsigned int size = min<unsigned int>(SLICE_LANES, count - start);
+            for (unsigned int i = 0; i < NUM_INPUTS; ++i) {
+                inputSlices[i].zero();
+            }
+            for (unsigned int k = 0; k < size; ++k) {
+                const unsigned long long * x = inputs[start + k].elements();
+                const unsigned long long lane = 1ULL << (k & 63);
+                for (unsigned int w = 0; w < INPUT_WORDS; ++w) {
+                    unsigned long long bits = x[w];
+                    while (bits != 0) {
+                        const unsigned int i = (w << 6) + __builtin_ctzll(bits);
+                        bits &= bits - 1;
+                        if (i < NUM_INPUTS) inputSlices[i].words[k >> 6] |= lane;
+                    }
+                }
+            }
+            evaluateSlices(inputSlices, outputSlices);
+            for (unsigned int k = 0; k < size; ++k) {
+                outputs[start + k].zero();
+            }
+            for (unsigned int o = 0; o < NUM_OUTPUTS; ++o) {
+                for (unsigned int q = 0; (q << 6) < size; ++q) {
+                    unsigned long long bits = outputSlices[o].words[q];
+                    while (bits != 0) {
+                        const unsigned int k = (q << 6) + __builtin_ctzll(bits);
+                        bits &= bits - 1;
+                        if (k < size) outputs[start + k].set(o);
+                    }
+                }
+            }
+        }
+    }
+
+private:
+    static const unsigned int NUM_GROUPS = (NUM_INPUT_MONOMIALS + 7) >> 3;
+    static const unsigned int INPUT_WORDS = (NUM_INPUTS + 63) >> 6;
+    static const unsigned int OUTPUT_WORDS = (NUM_OUTPUTS + 63) >> 6;
+
+    std::vector<unsigned char> _indices; //_indices[g * NUM_OUTPUTS + o] bit b: coefficient of monomial 8g + b in output o
+    BitVector<NUM_OUTPUTS> _constants;
+};
+
+#endif
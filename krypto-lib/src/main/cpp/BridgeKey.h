@@ -12,7 +12,7 @@
 #ifndef krypto_BridgeKey_h
 #define krypto_BridgeKey_h
 
-#include "PrivateKey.h"
+#include "DerivedKey.h"
 
 /*
  * Template for BridgeKey
@@ -34,9 +34,18 @@ public:
 	_Cu1(pk.getUnaryObf1()),
 	_Cu2(pk.getUnaryObf2()),
 	_Cb1(pk.getBinaryObf1()),
-	_Cb2(pk.getBinaryObf2())
+	_Cb2(pk.getBinaryObf2()),
+	_dk(pk)
 	{}
 
+	/*
+	 * Function: getDerivedKey
+	 * Returns the inverses and splits of the private matrices shared by all the generated components
+	 */
+	const DerivedKey<N> & getDerivedKey() const{
+		return _dk;
+	}
+
 /* Unary unified code */
 
 	/*
@@ -46,7 +55,7 @@ public:
 	const MultiQuadTuple<2*N, 2*N> getUnaryG1() const{
 		const MultiQuadTupleChain<N,2> & f = _pk.getf();
 
-		const BitMatrix<N, 2*N> & matTop = _M.inv().splitV2(1);
+		const BitMatrix<N, 2*N> & matTop = _dk.getMiSplit(1);
 		const BitMatrix<N, 2*N> & matBot = _R * matTop;
 
 		const MultiQuadTuple<2*N, N> & top = f.get(0) * matTop;
@@ -63,10 +72,8 @@ public:
 	const MultiQuadTuple<2*N, 2*N> getUnaryG2() const{
 		const MultiQuadTupleChain<N,2> & f = _pk.getf();
 
-		const BitMatrix<2*N> Cu1i = _Cu1.inv();
-
-		const BitMatrix<N, 2*N> & matTop = Cu1i.splitV2(0);
-		const BitMatrix<N, 2*N> & matBot = Cu1i.splitV2(1);
+		const BitMatrix<N, 2*N> & matTop = _dk.getUnaryObf1InvSplit(0);
+		const BitMatrix<N, 2*N> & matBot = _dk.getUnaryObf1InvSplit(1);
 
 		const MultiQuadTuple<2*N, N> & top = f.get(1) * matTop;
 		const MultiQuadTuple<2*N, N> & bot = f.get(1) * matBot;
@@ -87,11 +94,11 @@ public:
 
 		const BitMatrix<N, 2*N> & XTop = BitMatrix<N, 2*N>::augH(K, zeroN);
 		const BitMatrix<N, 2*N> & XBot = BitMatrix<N, 2*N>::augH(zeroN, _R);
-		const BitMatrix<2*N> & X = _M * BitMatrix<2*N>::augV(XTop, XBot) * _M.inv();
+		const BitMatrix<2*N> & X = _M * BitMatrix<2*N>::augV(XTop, XBot) * _dk.getMi();
 
 		const BitMatrix<N, 2*N> & YTop = BitMatrix<N, 2*N>::augH(K, BitMatrix<N>::identityMatrix());
 		const BitMatrix<N, 2*N> & YBot = BitMatrix<N, 2*N>::augH(zeroN, zeroN);
-		const BitMatrix<2*N> & Y = _M * BitMatrix<2*N>::augV(YTop, YBot) * _Cu2.inv();
+		const BitMatrix<2*N> & Y = _M * BitMatrix<2*N>::augV(YTop, YBot) * _dk.getUnaryObf2Inv();
 		return BitMatrix<2*N, 4*N>::augH(X, Y);
 	}
 
@@ -105,6 +112,16 @@ public:
 		return getLMMZ(BitMatrix<N>::leftShiftMatrix());
 	}	
 
+	/*
+	 * Function: getLeftShiftMatrix(n)
+	 * Returns a matrix used for homomorphic left shift by n
+	 */
+	const BitMatrix<2*N, 4*N> getLeftShiftMatrix(const unsigned int n) const{
+		BitMatrix<N> K = BitMatrix<N>::zeroMatrix();
+		for (unsigned int i = 0; i + n < N; ++i) K.set(i, i + n);
+		return getLMMZ(K);
+	}
+
 	/*
 	 * Function: getRightShiftMatrix
 	 * Returns a matrix RS used for homomorphic right shift
@@ -141,7 +158,7 @@ public:
 	const MultiQuadTuple<4*N, 3*N> getBinaryG1() const{
 		const MultiQuadTupleChain<N,2> & f = _pk.getf();
 
-		const BitMatrix<N, 2*N> & M2 = _M.inv().splitV2(1);
+		const BitMatrix<N, 2*N> & M2 = _dk.getMiSplit(1);
 		const BitMatrix<N, 4*N> & matTop = BitMatrix<N, 4*N>::augH(M2, BitMatrix<N, 2*N>::zeroMatrix());
 		const BitMatrix<N, 4*N> & matMid = BitMatrix<N, 4*N>::augH(BitMatrix<N, 2*N>::zeroMatrix(), M2);
 		const BitMatrix<N, 4*N> & matBot = (_Rx * matTop) ^ (_Ry * matMid);
@@ -161,10 +178,9 @@ public:
 	const MultiQuadTuple<3*N, 3*N>getBinaryG2() const{
 		const MultiQuadTupleChain<N,2> & f = _pk.getf();
 
-		const BitMatrix<3*N> & Cb1Inv = _Cb1.inv();
-		const BitMatrix<N, 3*N> & matTop = Cb1Inv.splitV3(0);
-		const BitMatrix<N, 3*N> & matMid = Cb1Inv.splitV3(1);
-		const BitMatrix<N, 3*N> & matBot = Cb1Inv.splitV3(2);
+		const BitMatrix<N, 3*N> & matTop = _dk.getBinaryObf1InvSplit(0);
+		const BitMatrix<N, 3*N> & matMid = _dk.getBinaryObf1InvSplit(1);
+		const BitMatrix<N, 3*N> & matBot = _dk.getBinaryObf1InvSplit(2);
 
 		const MultiQuadTuple<3*N, N> & top = f.get(1) * matTop;
 		const MultiQuadTuple<3*N, N> & mid = f.get(1) * matMid;
@@ -230,7 +246,7 @@ public:
 		H_AND result;
 		refreshParam();
 		const BitMatrix<2*N, N> & MB = _M.splitH2(0); // is this a possible security vulnerability??
-		const BitMatrix<2*N, 3*N> & MY3 = _M * BitMatrix<2*N, 3*N>::augV(_Cb2.inv().splitV3(2), BitMatrix<N, 3*N>::zeroMatrix());
+		const BitMatrix<2*N, 3*N> & MY3 = _M * BitMatrix<2*N, 3*N>::augV(_dk.getBinaryObf2InvSplit(2), BitMatrix<N, 3*N>::zeroMatrix());
 		result.initialize(MB, MY3, getANDz(), getANDZ1(), getANDZ2(), getBinaryG1(), getBinaryG2());
 		return result;
 	}
@@ -245,6 +261,7 @@ private:
 	const BitMatrix<2*N> _Cu2;
 	const BitMatrix<3*N> _Cb1;
 	const BitMatrix<3*N> _Cb2;
+	const DerivedKey<N> _dk; //inverses and splits of the matrices above
 	static const unsigned int twoN = N << 1;
 	static const unsigned int threeN = 3 * N;
 
@@ -267,7 +284,7 @@ private:
 	const BitMatrix<2*N> getXORXx() const{
 		const BitMatrix<N, 2*N> & XTop = BitMatrix<N, 2*N>::augH(BitMatrix<N>::identityMatrix(), BitMatrix<N>::zeroMatrix());
 		const BitMatrix<N, 2*N> & XBot = BitMatrix<N, 2*N>::augH(BitMatrix<N>::zeroMatrix(), _Rx);
-		return _M * BitMatrix<2*N>::augV(XTop, XBot) * _M.inv();
+		return _M * BitMatrix<2*N>::augV(XTop, XBot) * _dk.getMi();
 	}
 
 	/*
@@ -277,7 +294,7 @@ private:
 	const BitMatrix<2*N> getXORXy() const{
 		const BitMatrix<N, 2*N> XTop = BitMatrix<N, 2*N>::augH(BitMatrix<N>::identityMatrix(), BitMatrix<N>::zeroMatrix());
 		const BitMatrix<N, 2*N> XBot = BitMatrix<N, 2*N>::augH(BitMatrix<N>::zeroMatrix(), _Ry);
-		return _M * BitMatrix<2*N>::augV(XTop, XBot) * _M.inv();
+		return _M * BitMatrix<2*N>::augV(XTop, XBot) * _dk.getMi();
 	}
 
 	/*
@@ -288,7 +305,7 @@ private:
 		const BitMatrix<N> & idN = BitMatrix<N>::identityMatrix();
 
 		const BitMatrix<N, 3*N> & YTop = BitMatrix<N, 3*N>::augH(idN, idN, idN);
-		return _M * BitMatrix<2*N, 3*N>::augV(YTop, BitMatrix<N, 3*N>::zeroMatrix()) * _Cb2.inv();
+		return _M * BitMatrix<2*N, 3*N>::augV(YTop, BitMatrix<N, 3*N>::zeroMatrix()) * _dk.getBinaryObf2Inv();
 	}
 
 /* Helper functions for getAND */
@@ -298,8 +315,7 @@ private:
 	 * Returns matrix X used to compute z for homomorphic AND
 	 */
 	const BitMatrix<N, 2*N> getANDX() const{
-		const BitMatrix<N, 2*N> & inner = BitMatrix<N, 2*N>::augH(BitMatrix<N>::identityMatrix(), BitMatrix<N>::zeroMatrix());
-		return inner * _M.inv();
+		return _dk.getMiSplit(0); //[I | 0] * M^{-1}
 	}
 
 	/*
@@ -484,9 +500,8 @@ private:
 	 */
 	const MultiQuadTuple<7*N, N> getANDz() const{
 		const BitMatrix<N, 2*N> & X = getANDX();
-		const BitMatrix<3*N> & Cb2i = _Cb2.inv();
-		const BitMatrix<N, 3*N> & Y1 = Cb2i.splitV3(0);
-		const BitMatrix<N, 3*N> & Y2 = Cb2i.splitV3(1);
+		const BitMatrix<N, 3*N> & Y1 = _dk.getBinaryObf2InvSplit(0);
+		const BitMatrix<N, 3*N> & Y2 = _dk.getBinaryObf2InvSplit(1);
 		const BitMatrix<((7*N * (7*N + 1)) >> 1), N> & contrib = BitMatrix<((7*N * (7*N + 1)) >> 1), N>::augV(getANDP(X, Y2), getANDQ(X, Y1), getANDS(Y1, Y2));
 		MultiQuadTuple<7*N, N> z;
 		z.setContributions(contrib, BitVector<N>::zeroVector());
@@ -499,7 +514,7 @@ private:
 	 */
 	const BitMatrix<2*N> getANDZ1() const{
 		const BitMatrix<N, 2*N> & top = BitMatrix<N, 2*N>::zeroMatrix();
-		const BitMatrix<N, 2*N> & bottom = _Rx * _M.inv().splitV2(1);
+		const BitMatrix<N, 2*N> & bottom = _Rx * _dk.getMiSplit(1);
 		return _M * BitMatrix<2*N>::augV(top, bottom);
 	}
 
@@ -510,7 +525,7 @@ private:
 	 */
 	const BitMatrix<2*N> getANDZ2() const{
 		const BitMatrix<N, 2*N> & top = BitMatrix<N, 2*N>::zeroMatrix();
-		const BitMatrix<N, 2*N> & bottom = _Ry * _M.inv().splitV2(1);
+		const BitMatrix<N, 2*N> & bottom = _Ry * _dk.getMiSplit(1);
 		return _M * BitMatrix<2*N>::augV(top, bottom);
 	}
 
@@ -45,8 +45,7 @@ struct ClientHashFunction
      * Applied to x concatenated with y
      */
 	void generateHashMatrix(const BitMatrix<N, 2*N> & K, const PrivateKey<N> & pk){
-		const BitMatrix<2*N> & Mi = pk.getM().inv();
-		const BitMatrix<N, 2*N> & Mi1 = Mi.splitV2(0);
+		const BitMatrix<N, 2*N> & Mi1 = pk.getMi().splitV2(0);
 
 		const BitMatrix<N, 2*N> & decryptMatrix = Mi1;
 
@@ -62,7 +61,7 @@ struct ClientHashFunction
      * Applied to concealedF1(x) concatenated with concealedF1(y)
      */
 	const MultiQuadTuple<2*N, N> generateAugmentedF2(const BitMatrix<N> & C, const BitMatrix<N, 2*N> & K, const PrivateKey<N> & pk) const{
-		MultiQuadTuple<N, N> f2 = pk.getf().get(1);
+		const MultiQuadTuple<N, N> & f2 = pk.getf().get(1);
 		MultiQuadTuple<N, N> topBot = f2 * C;
 
         const BitMatrix<N> & I = BitMatrix<N>::identityMatrix();
@@ -81,8 +80,8 @@ struct ClientHashFunction
      * Applied to x and y separately
      */
 	 const MultiQuadTuple<2*N, N> generateConcealedF1(const BitMatrix<N> & C, const PrivateKey<N> & pk) const{
-		MultiQuadTuple<N, N> f1 = pk.getf().get(0);
-		const BitMatrix<N, 2*N> & inner = pk.getM().inv().splitV2(1);
+		const MultiQuadTuple<N, N> & f1 = pk.getf().get(0);
+		const BitMatrix<N, 2*N> & inner = pk.getMi().splitV2(1);
 		return (f1 * inner).rMult(C.inv());
 	}
 
@@ -0,0 +1,252 @@
+//
+//  FlatMultiQuadTuple.h
+//  krypto
+//
+//  Copyright (c) 2016 Kryptnostic. All rights reserved.
+//
+//  Flat layout of a MultiQuadTuple: every coefficient row in one aligned array
+//  Evaluation walks the monomials linearly instead of recursing through the levels
+//
+
+#ifndef krypto_FlatMultiQuadTuple_h
+#define krypto_FlatMultiQuadTuple_h
+
+#include "MultiQuadTuple.h"
+#include <cstdlib>
+#include <new>
+#include <vector>
+#define FLAT_MQT_ALIGNMENT 64 //cache line
+
+/*
+ * Template for FlatMultiQuadTuple
+ * Row monomialIndex(i, j) holds the coefficients of x_i x_j (i <= j), ordered by i then j,
+ * which is the order of the rows of the recursive coefficient matrices
+ * Row NUM_INPUT_MONOMIALS holds the constants
+ * The rows live on the heap; copies are deep, moves only transfer the allocation
+ */
+template<unsigned int NUM_INPUTS, unsigned int NUM_OUTPUTS>
+class FlatMultiQuadTuple {
+public:
+
+/* Constructors */
+
+    /*
+     * Default constructor
+     * Constructs a zero FlatMultiQuadTuple
+     */
+    FlatMultiQuadTuple() : _rows(allocate()) {
+        zero();
+    }
+
+    /*
+     * Constructor: (f)
+     * Constructs the flat layout of a recursive MultiQuadTuple
+     */
+    explicit FlatMultiQuadTuple(const MultiQuadTuple<NUM_INPUTS, NUM_OUTPUTS> & f) : _rows(allocate()) {
+        f.flatten(_rows);
+    }
+
+    FlatMultiQuadTuple(const FlatMultiQuadTuple<NUM_INPUTS, NUM_OUTPUTS> & rhs) : _rows(allocate()) {
+        memcpy(_rows, rhs._rows, NUM_ROWS * sizeof(BitVector<NUM_OUTPUTS>));
+    }
+
+    FlatMultiQuadTuple(FlatMultiQuadTuple<NUM_INPUTS, NUM_OUTPUTS> && rhs) : _rows(rhs._rows) {
+        rhs._rows = NULL;
+    }
+
+    ~FlatMultiQuadTuple() {
+        free(_rows);
+    }
+
+    /*
+     * Operator: =
+     * Copies or moves rhs in depending on how the argument was constructed
+     */
+    FlatMultiQuadTuple<NUM_INPUTS, NUM_OUTPUTS> & operator=(FlatMultiQuadTuple<NUM_INPUTS, NUM_OUTPUTS> rhs) {
+        std::swap(_rows, rhs._rows);
+        return *this;
+    }
+
+/* Generation */
+
+    /*
+     * Function: randomize()
+     * Sets every coefficient and constant at random
+     */
+    void randomize() {
+        for (unsigned int i = 0; i < NUM_ROWS; ++i) {
+            _rows[i] = BitVector<NUM_OUTPUTS>::randomVector();
+        }
+    }
+
+    /*
+     * Function: zero()
+     * Sets every coefficient and constant to zero
+     */
+    void zero() {
+        memset(_rows, 0, NUM_ROWS * sizeof(BitVector<NUM_OUTPUTS>));
+    }
+
+/* Conversion */
+
+    /*
+     * Function: set(f)
+     * Sets the rows from a recursive MultiQuadTuple
+     */
+    void set(const MultiQuadTuple<NUM_INPUTS, NUM_OUTPUTS> & f) {
+        f.flatten(_rows);
+    }
+
+    /*
+     * Function: toMQT(f)
+     * Writes the coefficients into a recursive MultiQuadTuple
+     * Output parameter because large MultiQuadTuples do not belong on the return path
+     */
+    void toMQT(MultiQuadTuple<NUM_INPUTS, NUM_OUTPUTS> & f) const {
+        f.setFlat(_rows);
+    }
+
+/* Getters */
+
+    /*
+     * Function: monomialIndex(i, j)
+     * Returns the row of the monomial x_i x_j, assumes i <= j
+     */
+    static unsigned int monomialIndex(const unsigned int i, const unsigned int j) {
+        return i * NUM_INPUTS - ((i * (i - 1)) >> 1) + (j - i);
+    }
+
+    /*
+     * Operator: [monomial]
+     * Returns the coefficient row at a given index
+     */
+    BitVector<NUM_OUTPUTS> & operator[](const unsigned int monomial) {
+        if (DEBUG) assert(monomial < NUM_ROWS);
+        return _rows[monomial];
+    }
+
+    const BitVector<NUM_OUTPUTS> & operator[](const unsigned int monomial) const {
+        if (DEBUG) assert(monomial < NUM_ROWS);
+        return _rows[monomial];
+    }
+
+    const BitVector<NUM_OUTPUTS> & getConstants() const {
+        return _rows[NUM_INPUT_MONOMIALS];
+    }
+
+    bool equals(const FlatMultiQuadTuple<NUM_INPUTS, NUM_OUTPUTS> & rhs) const {
+        for (unsigned int i = 0; i < NUM_ROWS; ++i) {
+            if (!_rows[i].equals(rhs._rows[i])) return false;
+        }
+        return true;
+    }
+
+/* Evaluation */
+
+    /*
+     * Operator: (input)
+     * Evaluates on an input vector
+     * For each set bit x_i the rows x_i x_j are contiguous, so only the set bits j >= i
+     * of the input are visited, a word at a time
+     */
+    const BitVector<NUM_OUTPUTS> operator() (const BitVector<NUM_INPUTS> & input) const {
+        BitVector<NUM_OUTPUTS> result = getConstants();
+        unsigned long long x[INPUT_WORDS];
+        memcpy(x, input.elements(), sizeof(x));
+        x[INPUT_WORDS - 1] &= LAST_WORD_MASK;
+        for (unsigned int wi = 0; wi < INPUT_WORDS; ++wi) {
+            unsigned long long bitsI = x[wi];
+            while (bitsI != 0) {
+                const unsigned int i = (wi << 6) + __builtin_ctzll(bitsI);
+                bitsI &= bitsI - 1;
+                const BitVector<NUM_OUTPUTS> * row = _rows + monomialIndex(i, 0); //row[j] is x_i x_j
+                unsigned long long bitsJ = x[wi] & (~0ULL << (i & 63));
+                for (unsigned int wj = wi; ; ) {
+                    while (bitsJ != 0) {
+                        result ^= row[(wj << 6) + __builtin_ctzll(bitsJ)];
+                        bitsJ &= bitsJ - 1;
+                    }
+                    if (++wj == INPUT_WORDS) break;
+                    bitsJ = x[wj];
+                }
+            }
+        }
+        return result;
+    }
+
+    /*
+     * Function: partialEval(input)
+     * Returns the function of the last NUM_INPUTS - PARTIAL_INPUTS inputs obtained by fixing
+     * the first PARTIAL_INPUTS inputs to input (same as MultiQuadTuple::partialEval)
+     * The quadratic rows among the remaining inputs are the contiguous tail of the layout and
+     * are copied as one block. For every set fixed input x_a, its rows x_a x_b with b fixed
+     * go into the constants and its rows with b free (y_b^2 = y_b) are one block XORed into
+     * the linear terms, which are then folded onto the diagonal of the result
+     */
+    template<unsigned int PARTIAL_INPUTS>
+    FlatMultiQuadTuple<NUM_INPUTS - PARTIAL_INPUTS, NUM_OUTPUTS> partialEval(const BitVector<PARTIAL_INPUTS> & input) const {
+        typedef FlatMultiQuadTuple<NUM_INPUTS - PARTIAL_INPUTS, NUM_OUTPUTS> Result;
+        const unsigned int numFree = NUM_INPUTS - PARTIAL_INPUTS;
+        const unsigned int numFreeMonomials = (numFree * (numFree + 1)) >> 1;
+        const unsigned int partialWords = (PARTIAL_INPUTS + 63) >> 6;
+        const size_t rowWords = sizeof(BitVector<NUM_OUTPUTS>) >> 3;
+
+        Result result;
+        memcpy(&result[0], _rows + monomialIndex(PARTIAL_INPUTS, PARTIAL_INPUTS), numFreeMonomials * sizeof(BitVector<NUM_OUTPUTS>));
+        BitVector<NUM_OUTPUTS> constants = getConstants();
+        vector<BitVector<NUM_OUTPUTS> > linear(numFree); //linear[b] is y_b, value-initialized to zero
+
+        unsigned long long x[partialWords];
+        memcpy(x, input.elements(), sizeof(x));
+        if (PARTIAL_INPUTS & 63) x[partialWords - 1] &= (1ULL << (PARTIAL_INPUTS & 63)) - 1;
+        for (unsigned int wa = 0; wa < partialWords; ++wa) {
+            unsigned long long bitsA = x[wa];
+            while (bitsA != 0) {
+                const unsigned int a = (wa << 6) + __builtin_ctzll(bitsA);
+                bitsA &= bitsA - 1;
+                const BitVector<NUM_OUTPUTS> * row = _rows + monomialIndex(a, 0); //row[b] is x_a x_b
+                unsigned long long bitsB = x[wa] & (~0ULL << (a & 63));
+                for (unsigned int wb = wa; ; ) {
+                    while (bitsB != 0) {
+                        constants ^= row[(wb << 6) + __builtin_ctzll(bitsB)];
+                        bitsB &= bitsB - 1;
+                    }
+                    if (++wb == partialWords) break;
+                    bitsB = x[wb];
+                }
+                if (numFree > 0) SimdKernels::get().xorInto(linear[0].elements(), row[PARTIAL_INPUTS].elements(), numFree * rowWords);
+            }
+        }
+
+        for (unsigned int b = 0; b < numFree; ++b) {
+            result[Result::monomialIndex(b, b)] ^= linear[b];
+        }
+        result[numFreeMonomials] = constants;
+        return result;
+    }
+
+/* Modifiers */
+
+    /*
+     * Function: xorConstants(v)
+     * XORs v into the constants
+     */
+    void xorConstants(const BitVector<NUM_OUTPUTS> & v) {
+        _rows[NUM_INPUT_MONOMIALS] ^= v;
+    }
+
+private:
+    static const unsigned int NUM_ROWS = NUM_INPUT_MONOMIALS + 1;
+    static const unsigned int INPUT_WORDS = (NUM_INPUTS + 63) >> 6;
+    static const unsigned long long LAST_WORD_MASK = (NUM_INPUTS & 63) ? (1ULL << (NUM_INPUTS & 63)) - 1 : ~0ULL;
+
+    BitVector<NUM_OUTPUTS> * _rows;
+
+    static BitVector<NUM_OUTPUTS> * allocate() {
+        void * memory = NULL;
+        if (posix_memalign(&memory, FLAT_MQT_ALIGNMENT, NUM_ROWS * sizeof(BitVector<NUM_OUTPUTS>)) != 0) throw std::bad_alloc();
+        return static_cast<BitVector<NUM_OUTPUTS> *>(memory);
+    }
+};
+
+#endif
@@ -0,0 +1,207 @@
+//
+//  HomomorphicCircuit.h
+//  krypto
+//
+//  Copyright (c) 2016 Kryptnostic. All rights reserved.
+//
+//  Circuit builder and scheduler for homomorphic operations
+//	Records a DAG of PublicKey gates, then evaluates independent gates in parallel
+//
+
+#ifndef krypto_HomomorphicCircuit_h
+#define krypto_HomomorphicCircuit_h
+
+#include "PublicKey.h"
+#include "ThreadPool.h"
+#include <map>
+#include <tuple>
+
+/*
+ * Template for HomomorphicCircuit
+ * Gates are identified by wires (indices into the circuit); building a gate that
+ * already exists returns the existing wire, so common subexpressions are shared
+ */
+template<unsigned int N>
+class HomomorphicCircuit {
+public:
+	typedef unsigned int Wire;
+
+	HomomorphicCircuit() : _numInputs(0) {
+	}
+
+/* Construction */
+
+	/*
+	 * Function: input()
+	 * Returns a new input wire; inputs are bound in creation order at evaluation
+	 */
+	Wire input() {
+		return addGate(INPUT_GATE, _numInputs++, 0, 0, 0);
+	}
+
+	Wire XOR(const Wire x, const Wire y) {
+		return addGate(XOR_GATE, min(x, y), max(x, y), 0, 1 + max(_gates[x].level, _gates[y].level));
+	}
+
+	Wire AND(const Wire x, const Wire y) {
+		return addGate(AND_GATE, min(x, y), max(x, y), 0, 1 + max(_gates[x].level, _gates[y].level));
+	}
+
+	Wire LEFTSHIFT(const Wire x) {
+		return addGate(LEFTSHIFT_GATE, x, 0, 0, 1 + _gates[x].level);
+	}
+
+	Wire RIGHTSHIFT(const Wire x) {
+		return addGate(RIGHTSHIFT_GATE, x, 0, 0, 1 + _gates[x].level);
+	}
+
+	/*
+	 * Function: LMM(Z, x)
+	 * Returns the wire of homomorphicLMM(Z, x); equal matrices are stored once
+	 */
+	Wire LMM(const BitMatrix<2*N, 4*N> & Z, const Wire x) {
+		unsigned int matrix = 0;
+		while (matrix < _matrices.size() && !_matrices[matrix].equals(Z)) ++matrix;
+		if (matrix == _matrices.size()) _matrices.push_back(Z);
+		return addGate(LMM_GATE, x, 0, matrix, 1 + _gates[x].level);
+	}
+
+	/*
+	 * Function: size()
+	 * Returns the number of distinct gates, inputs included
+	 */
+	unsigned int size() const {
+		return _gates.size();
+	}
+
+/* Evaluation */
+
+	/*
+	 * Function: evaluate(pk, inputs, outputs, pool)
+	 * Returns the values of the output wires given ciphertexts for the input wires
+	 * Only gates the outputs depend on are evaluated. Gates of the same depth are
+	 * independent: they are sorted by type, spread over the workers of pool, and
+	 * consecutive LMM/shift gates with the same matrix are applied as one batch
+	 */
+	const vector<BitVector<2*N> > evaluate(const PublicKey<N> & pk, const vector<BitVector<2*N> > & inputs, const vector<Wire> & outputs, ThreadPool & pool) const {
+		vector<BitVector<2*N> > values(_gates.size());
+		const vector<vector<Wire> > & levels = schedule(inputs, outputs, values);
+		for (unsigned int l = 1; l < levels.size(); ++l) {
+			const vector<Wire> & level = levels[l];
+			const unsigned int grain = level.size() / (4 * pool.size()) + 1;
+			pool.parallelFor(level.size(), grain, [&](const unsigned int start, const unsigned int size) {
+				evaluateGates(pk, level, start, size, values);
+			});
+		}
+		return collect(outputs, values);
+	}
+
+	/*
+	 * Function: evaluate(pk, inputs, outputs)
+	 * Same as above on the calling thread only
+	 */
+	const vector<BitVector<2*N> > evaluate(const PublicKey<N> & pk, const vector<BitVector<2*N> > & inputs, const vector<Wire> & outputs) const {
+		vector<BitVector<2*N> > values(_gates.size());
+		const vector<vector<Wire> > & levels = schedule(inputs, outputs, values);
+		for (unsigned int l = 1; l < levels.size(); ++l) {
+			evaluateGates(pk, levels[l], 0, levels[l].size(), values);
+		}
+		return collect(outputs, values);
+	}
+
+private:
+	enum GateType { INPUT_GATE, XOR_GATE, AND_GATE, LEFTSHIFT_GATE, RIGHTSHIFT_GATE, LMM_GATE };
+
+	struct Gate {
+		GateType type;
+		unsigned int lhs; //operand wire, or input index for INPUT_GATE
+		unsigned int rhs; //second operand wire of XOR_GATE and AND_GATE
+		unsigned int matrix; //index into _matrices for LMM_GATE
+		unsigned int level; //depth in the circuit, inputs are at 0
+	};
+
+	vector<Gate> _gates;
+	vector<BitMatrix<2*N, 4*N> > _matrices;
+	map<tuple<int, unsigned int, unsigned int, unsigned int>, Wire> _index; //gate -> wire, for deduplication
+	unsigned int _numInputs;
+
+	Wire addGate(const GateType type, const unsigned int lhs, const unsigned int rhs, const unsigned int matrix, const unsigned int level) {
+		const tuple<int, unsigned int, unsigned int, unsigned int> key(type, lhs, rhs, matrix);
+		typename map<tuple<int, unsigned int, unsigned int, unsigned int>, Wire>::const_iterator it = _index.find(key);
+		if (it != _index.end()) return it->second;
+		const Gate gate = {type, lhs, rhs, matrix, level};
+		_gates.push_back(gate);
+		_index[key] = _gates.size() - 1;
+		return _gates.size() - 1;
+	}
+
+	/*
+	 * Function: schedule(inputs, outputs, values)
+	 * Binds the inputs into values and returns the gates needed by outputs, grouped by
+	 * level and sorted by type and matrix within each level
+	 */
+	const vector<vector<Wire> > schedule(const vector<BitVector<2*N> > & inputs, const vector<Wire> & outputs, vector<BitVector<2*N> > & values) const {
+		if (DEBUG) assert(inputs.size() == _numInputs);
+		vector<bool> needed(_gates.size(), false);
+		for (unsigned int i = 0; i < outputs.size(); ++i) needed[outputs[i]] = true;
+		unsigned int depth = 0;
+		for (unsigned int w = _gates.size(); w-- > 0; ) { //operands always precede their gates
+			if (!needed[w]) continue;
+			const Gate & gate = _gates[w];
+			depth = max(depth, gate.level);
+			if (gate.type == INPUT_GATE) {
+				values[w] = inputs[gate.lhs];
+				continue;
+			}
+			needed[gate.lhs] = true;
+			if (gate.type == XOR_GATE || gate.type == AND_GATE) needed[gate.rhs] = true;
+		}
+		vector<vector<Wire> > levels(depth + 1);
+		for (unsigned int w = 0; w < _gates.size(); ++w) {
+			if (needed[w]) levels[_gates[w].level].push_back(w);
+		}
+		for (unsigned int l = 1; l < levels.size(); ++l) {
+			sort(levels[l].begin(), levels[l].end(), [this](const Wire a, const Wire b) {
+				return make_pair(_gates[a].type, _gates[a].matrix) < make_pair(_gates[b].type, _gates[b].matrix);
+			});
+		}
+		return levels;
+	}
+
+	/*
+	 * Function: evaluateGates(pk, level, start, size, values)
+	 * Evaluates level[start, start + size) into values, batching runs of LMM/shift gates
+	 */
+	void evaluateGates(const PublicKey<N> & pk, const vector<Wire> & level, const unsigned int start, const unsigned int size, vector<BitVector<2*N> > & values) const {
+		vector<BitVector<2*N> > operands, results;
+		unsigned int i = start;
+		while (i < start + size) {
+			const Gate & gate = _gates[level[i]];
+			if (gate.type == XOR_GATE || gate.type == AND_GATE) {
+				values[level[i]] = gate.type == XOR_GATE ? pk.homomorphicXOR(values[gate.lhs], values[gate.rhs]) : pk.homomorphicAND(values[gate.lhs], values[gate.rhs]);
+				++i;
+				continue;
+			}
+			unsigned int end = i;
+			operands.clear();
+			while (end < start + size && _gates[level[end]].type == gate.type && _gates[level[end]].matrix == gate.matrix) {
+				operands.push_back(values[_gates[level[end]].lhs]);
+				++end;
+			}
+			results.resize(operands.size());
+			if (gate.type == LEFTSHIFT_GATE) pk.homomorphicLEFTSHIFTBatch(&operands[0], &results[0], operands.size());
+			else if (gate.type == RIGHTSHIFT_GATE) pk.homomorphicRIGHTSHIFTBatch(&operands[0], &results[0], operands.size());
+			else pk.homomorphicLMMBatch(_matrices[gate.matrix], &operands[0], &results[0], operands.size());
+			for (unsigned int k = 0; k < operands.size(); ++k) values[level[i + k]] = results[k];
+			i = end;
+		}
+	}
+
+	const vector<BitVector<2*N> > collect(const vector<Wire> & outputs, const vector<BitVector<2*N> > & values) const {
+		vector<BitVector<2*N> > result(outputs.size());
+		for (unsigned int i = 0; i < outputs.size(); ++i) result[i] = values[outputs[i]];
+		return result;
+	}
+};
+
+#endif
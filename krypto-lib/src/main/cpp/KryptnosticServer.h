@@ -13,6 +13,9 @@
 #define krypto_KryptnosticServer_h
 
 #include "ClientHashFunction.h"
+#include "BitSlicedMultiQuadTuple.h"
+#include "PreparedBitMatrix.h"
+#include "ThreadPool.h"
 
 template<unsigned int N = 128>
 class KryptnosticServer {
@@ -29,14 +32,17 @@ public:
      */
 	KryptnosticServer(const ClientHashFunction<N> & cHashFunction, const BitVector<2*N> & eSearchToken) :
 	_concealedF1(cHashFunction.concealedF1),
-	_hashMatrixR(cHashFunction.hashMatrix.splitH2(1))
+	_hashMatrixR(cHashFunction.hashMatrix.splitH2(1)),
+	_hashMatrixRt(_hashMatrixR.transpose()),
+	_preparedHashMatrixR(_hashMatrixR),
+	//partial eval of cHashFunction on eSearchToken, over the flat layout
+	_tokenAddressFunction(FlatMultiQuadTuple<2*N, N>(cHashFunction.augmentedF2).template partialEval<N>(_concealedF1(eSearchToken))),
+	_slicedF1(_concealedF1)
 	{
-		//set _tokenAddressFunction to partial eval of cHashFunction on eSearchToken
-		_tokenAddressFunction = (cHashFunction.augmentedF2).template partialEval<N>(_concealedF1(eSearchToken));
-
 		//add hashMatrix partial evaluation to consts of _tokenAddressFunction
 		const BitVector<N> & hashMatrixPartialEval = cHashFunction.hashMatrix.splitH2(0) * eSearchToken;
 		_tokenAddressFunction.xorConstants(hashMatrixPartialEval);
+		_slicedTokenAddressFunction = BitSlicedMultiQuadTuple<N, N>(_tokenAddressFunction);
 	}
 
 /* Registration */
@@ -51,15 +57,64 @@ public:
 		const BitMatrix<N> & objectConversionMatrix = objectSearchPair.second; //get from pair
 
 		// return cHashFunction(eSearchToken, eObscuredObjectSearchKey);
-		const BitVector<N> & fullEval = _tokenAddressFunction(_concealedF1(eObjectSearchKey)) ^ (_hashMatrixR * eObjectSearchKey);
+		const BitVector<N> & fullEval = _tokenAddressFunction(_concealedF1(eObjectSearchKey)) ^ (_preparedHashMatrixR * eObjectSearchKey);
 		return objectConversionMatrix * fullEval;
 	}
 
+	/*
+	 * Function: getMetadataAddresses(objectSearchPairs, addresses, count)
+	 * Computes getMetadataAddress for count object search pairs into addresses
+	 * The encrypted ObjectSearchKeys are stacked as rows of a block so the linear
+	 * part of the hash is one matrix product per block instead of one per pair,
+	 * and blocks of at least SLICE_BATCH_MIN pairs evaluate the quadratic part bit-sliced
+	 */
+	void getMetadataAddresses(const std::pair <BitVector<2*N>, BitMatrix<N> > * objectSearchPairs, BitVector<N> * addresses, const unsigned int count) const{
+		BitMatrix<BATCH_BLOCK_ROWS, 2*N> keys = BitMatrix<BATCH_BLOCK_ROWS, 2*N>::zeroMatrix();
+		for (unsigned int start = 0; start < count; start += BATCH_BLOCK_ROWS) {
+			const unsigned int size = min<unsigned int>(BATCH_BLOCK_ROWS, count - start);
+			for (unsigned int j = 0; j < size; ++j) {
+				keys[j] = objectSearchPairs[start + j].first;
+			}
+			const BitMatrix<BATCH_BLOCK_ROWS, N> & hashed = keys * _hashMatrixRt;
+			if (size >= SLICE_BATCH_MIN) {
+				BitVector<N> concealed[BATCH_BLOCK_ROWS];
+				BitVector<N> tokenEvals[BATCH_BLOCK_ROWS];
+				_slicedF1.evaluateBatch(&keys[0], concealed, size);
+				_slicedTokenAddressFunction.evaluateBatch(concealed, tokenEvals, size);
+				for (unsigned int j = 0; j < size; ++j) {
+					addresses[start + j] = objectSearchPairs[start + j].second * (tokenEvals[j] ^ hashed[j]);
+				}
+				continue;
+			}
+			for (unsigned int j = 0; j < size; ++j) {
+				const BitVector<N> & fullEval = _tokenAddressFunction(_concealedF1(keys[j])) ^ hashed[j];
+				addresses[start + j] = objectSearchPairs[start + j].second * fullEval;
+			}
+		}
+	}
+
+	/*
+	 * Function: getMetadataAddressesParallel(objectSearchPairs, addresses, count, pool)
+	 * Computes getMetadataAddresses with the pairs partitioned in blocks over the workers of pool
+	 * Addresses are written in input order; the server is read-only after construction,
+	 * so all workers share it
+	 */
+	void getMetadataAddressesParallel(const std::pair <BitVector<2*N>, BitMatrix<N> > * objectSearchPairs, BitVector<N> * addresses, const unsigned int count, ThreadPool & pool) const{
+		const unsigned int grain = min<unsigned int>(BATCH_BLOCK_ROWS, count / (4 * pool.size()) + 1); //a few chunks per worker to balance
+		pool.parallelFor(count, grain, [&](const unsigned int start, const unsigned int size) {
+			getMetadataAddresses(objectSearchPairs + start, addresses + start, size);
+		});
+	}
+
 
 private:
 	const BitMatrix<N, 2*N> _hashMatrixR;
+	const BitMatrix<2*N, N> _hashMatrixRt; //transpose of _hashMatrixR, used by the batch operations
+	const PreparedBitMatrix<N, 2*N> _preparedHashMatrixR; //column tables of _hashMatrixR, used per pair
 	const MultiQuadTuple<2*N, N> _concealedF1;
-	MultiQuadTuple<N, N> _tokenAddressFunction;
+	FlatMultiQuadTuple<N, N> _tokenAddressFunction;
+	const BitSlicedMultiQuadTuple<2*N, N> _slicedF1; //bit-sliced forms of the two functions above, for batches
+	BitSlicedMultiQuadTuple<N, N> _slicedTokenAddressFunction;
 };
 
 #endif
\ No newline at end of file
@@ -153,6 +153,33 @@ struct MultiQuadTuple {
         return *this;
     }
 
+/* Flat layout */
+
+    /*
+     * Function: flatten(rows)
+     * Copies the coefficient rows into a contiguous array, one row per monomial x_i x_j (i <= j)
+     * in order of i then j, followed by the constants (see FlatMultiQuadTuple)
+     * Ends with a template specialization at limit = 0
+     */
+    void flatten(BitVector<NUM_OUTPUTS> * rows) const {
+        for (unsigned int i = 0; i < LIMIT; ++i) {
+            rows[i] = _matrix[i];
+        }
+        next.flatten(rows + LIMIT);
+    }
+
+    /*
+     * Function: setFlat(rows)
+     * Inverse of flatten: sets the coefficient rows and constants from a contiguous array
+     * Ends with a template specialization at limit = 0
+     */
+    void setFlat(const BitVector<NUM_OUTPUTS> * rows) {
+        for (unsigned int i = 0; i < LIMIT; ++i) {
+            _matrix[i] = rows[i];
+        }
+        next.setFlat(rows + LIMIT);
+    }
+
 /* Evaluation */
 
     /*
@@ -277,9 +304,55 @@ struct MultiQuadTuple {
     /*
      * Operator: * inner
      * Evaluates the MultiQuadTuple composed with a given matrix (e.g. f \circ inner)
+     * With L = inner and Q_ab the coefficients of x_a x_b (a <= b), the coefficients of y_i y_j
+     * are R_ij + R_ji (R_ii on the diagonal) where R_ij = sum_a L_ai sum_b L_bj Q_ab, i.e.
+     * R = L^T Q L with Q as an upper triangular matrix of coefficient vectors. Both sums are
+     * products by L^T of whole blocks of coefficient rows, so they run on the M4RM product:
+     * P_a = L^T [Q_a0; ...; Q_a(n-1)] for every a, then R_.j = L^T [P_0[j]; ...; P_(n-1)[j]] for every j
+     * Only called on the root (LIMIT = NUM_INPUTS)
      */
     template<unsigned int NUM_INNER_INPUTS>
     const MultiQuadTuple<NUM_INNER_INPUTS,NUM_OUTPUTS> operator*( const BitMatrix<NUM_INPUTS, NUM_INNER_INPUTS> & inner) const{
+        if (DEBUG) assert(LIMIT == NUM_INPUTS);
+        const BitMatrix<NUM_INNER_INPUTS, NUM_INPUTS> & innerTranspose = inner.transpose();
+        vector<BitVector<NUM_OUTPUTS> > rows(NUM_INPUT_MONOMIALS + 1);
+        flatten(&rows[0]);
+
+        vector<BitVector<NUM_OUTPUTS> > partial(NUM_INNER_INPUTS * NUM_INPUTS); //partial[j * NUM_INPUTS + a] = P_a[j]
+        BitMatrix<NUM_INPUTS, NUM_OUTPUTS> block = BitMatrix<NUM_INPUTS, NUM_OUTPUTS>::zeroMatrix();
+        const BitVector<NUM_OUTPUTS> * Qa = &rows[0]; //Qa[b - a] = Q_ab
+        for (unsigned int a = 0; a < NUM_INPUTS; ++a) {
+            if (a > 0) block[a - 1].zero();
+            for (unsigned int b = a; b < NUM_INPUTS; ++b) block[b] = Qa[b - a];
+            Qa += NUM_INPUTS - a;
+            const BitMatrix<NUM_INNER_INPUTS, NUM_OUTPUTS> & P = innerTranspose * block;
+            for (unsigned int j = 0; j < NUM_INNER_INPUTS; ++j) partial[j * NUM_INPUTS + a] = P[j];
+        }
+
+        const unsigned int numComposedMonomials = (NUM_INNER_INPUTS * (NUM_INNER_INPUTS + 1)) >> 1;
+        vector<BitVector<NUM_OUTPUTS> > composed(numComposedMonomials + 1); //value-initialized to zero
+        for (unsigned int j = 0; j < NUM_INNER_INPUTS; ++j) {
+            for (unsigned int a = 0; a < NUM_INPUTS; ++a) block[a] = partial[j * NUM_INPUTS + a];
+            const BitMatrix<NUM_INNER_INPUTS, NUM_OUTPUTS> & R = innerTranspose * block; //R[i] = R_ij
+            for (unsigned int i = 0; i < NUM_INNER_INPUTS; ++i) {
+                const unsigned int lo = min(i, j), hi = max(i, j);
+                composed[lo * NUM_INNER_INPUTS - ((lo * (lo - 1)) >> 1) + (hi - lo)] ^= R[i];
+            }
+        }
+        composed[numComposedMonomials] = rows[NUM_INPUT_MONOMIALS];
+
+        MultiQuadTuple<NUM_INNER_INPUTS,NUM_OUTPUTS> cs;
+        cs.setFlat(&composed[0]);
+        return cs;
+    }
+
+    /*
+     * Function: naiveCompose(inner)
+     * Same as operator* by walking the levels one coefficient matrix at a time
+     * Kept as the reference implementation for operator*
+     */
+    template<unsigned int NUM_INNER_INPUTS>
+    const MultiQuadTuple<NUM_INNER_INPUTS,NUM_OUTPUTS> naiveCompose(const BitMatrix<NUM_INPUTS, NUM_INNER_INPUTS> & inner) const{
         MultiQuadTuple<NUM_INNER_INPUTS,NUM_OUTPUTS> cs;
         cs.setAsConstants(getConstants()); //reset contribution matrix and force constants
         compose(cs, inner.transpose());
@@ -521,6 +594,24 @@ struct MultiQuadTuple<NUM_INPUTS,NUM_OUTPUTS,0> {
         _constants = v;
     }
 
+/* Base case of Flat layout */
+
+    /*
+     * Function: flatten(rows)
+     * Last step of flattening: the constants are the final row
+     */
+    void flatten(BitVector<NUM_OUTPUTS> * rows) const {
+        rows[0] = _constants;
+    }
+
+    /*
+     * Function: setFlat(rows)
+     * Last step of setting from a flat array: the final row holds the constants
+     */
+    void setFlat(const BitVector<NUM_OUTPUTS> * rows) {
+        _constants = rows[0];
+    }
+
 /* Evaluation */
 
     /*
@@ -12,7 +12,9 @@
 #define krypto_MultiQuadTupleChain_h
 
 #include <vector>
-#include "MultiQuadTuple.h"
+#include "BitSlicedMultiQuadTuple.h"
+#define CHAIN_FLAT_MIN 8 //batch size from which flattening the stages pays for itself
+#define CHAIN_SLICE_MIN 512 //batch size from which bit-slicing the stages beats the flat layout
 
 //for now, assuming that the input and output all live in F_2^{N*2^6}
 //ChainPolynomialFunctionTuple f = {f_1,...,f_L}, f_i: F_2^N -> F_2^N
@@ -37,15 +39,62 @@ public:
         return result;
     }
 
-	const BitVector<N> operator()(const BitVector<N> m) const{
-		BitVector<N> result = m;
-		for(unsigned int i = 0; i < L; ++i){
+	const BitVector<N> operator()(const BitVector<N> & m) const{
+		BitVector<N> result = _tuple[0](m);
+		for(unsigned int i = 1; i < L; ++i){
 			result = (_tuple[i])(result);
 		}
 		return result;
 	}
 
-	const MultiQuadTuple<N,N> get(const unsigned int index) const{
+	/*
+	 * Function: evaluateBatch(inputs, outputs, count)
+	 * Evaluates the chain on count inputs into outputs, which may alias inputs
+	 * The stages are converted once per call: to the flat layout from CHAIN_FLAT_MIN inputs,
+	 * each input then going through all L flat stages in turn, and bit-sliced from
+	 * CHAIN_SLICE_MIN inputs, each block of SLICE_LANES inputs then going through all
+	 * L stages while it is in cache
+	 */
+	void evaluateBatch(const BitVector<N> * inputs, BitVector<N> * outputs, const unsigned int count) const{
+		if (count < CHAIN_FLAT_MIN) {
+			for (unsigned int k = 0; k < count; ++k) {
+				outputs[k] = (*this)(inputs[k]);
+			}
+		} else if (count < CHAIN_SLICE_MIN) {
+			std::vector<FlatMultiQuadTuple<N,N> > stages;
+			stages.reserve(L);
+			for (unsigned int i = 0; i < L; ++i) {
+				stages.push_back(FlatMultiQuadTuple<N,N>(_tuple[i]));
+			}
+			for (unsigned int k = 0; k < count; ++k) {
+				BitVector<N> result = stages[0](inputs[k]);
+				for (unsigned int i = 1; i < L; ++i) {
+					result = stages[i](result);
+				}
+				outputs[k] = result;
+			}
+		} else {
+			std::vector<BitSlicedMultiQuadTuple<N,N> > stages;
+			stages.reserve(L);
+			for (unsigned int i = 0; i < L; ++i) {
+				stages.push_back(BitSlicedMultiQuadTuple<N,N>(_tuple[i]));
+			}
+			for (unsigned int start = 0; start < count; start += SLICE_LANES) {
+				const unsigned int size = min<unsigned int>(SLICE_LANES, count - start);
+				stages[0].evaluateBatch(inputs + start, outputs + start, size);
+				for (unsigned int i = 1; i < L; ++i) {
+					stages[i].evaluateBatch(outputs + start, outputs + start, size);
+				}
+			}
+		}
+	}
+
+	/*
+	 * Function: get(index)
+	 * Returns a reference to the tuple f_{index + 1}, valid as long as the chain
+	 */
+	const MultiQuadTuple<N,N> & get(const unsigned int index) const{
+		if (DEBUG) assert(index < L);
 		return _tuple[index];
 	}
 
@@ -13,6 +13,7 @@
 #define krypto_PrivateKey_h
 
 #include "MultiQuadTupleChain.h"
+#define BATCH_BLOCK_ROWS 256 //ciphertexts handled by each matrix product in the batch operations
 
 /*
  * Template for PrivateKey
@@ -25,6 +26,7 @@ template<unsigned int N1> friend class BridgeKey;
 template<unsigned int N2> friend class ClientHashFunction;
 template<unsigned int N3> friend class SearchPrivateKey;
 template<unsigned int N4> friend class KryptnosticClient;
+template<unsigned int N5> friend class DerivedKey;
 
 public:
 
@@ -34,6 +36,7 @@ public:
      */
 	PrivateKey():
 		_M(BitMatrix<2*N>::randomInvertibleMatrix()),
+		_Mi(_M.inv()),
 		_f(MultiQuadTupleChain<N,2>::randomMultiQuadTupleChain()){
 		generateObfuscationMatrixChains();
 	}
@@ -54,19 +57,76 @@ public:
      * Returns the decrypted plaintext (length N * 2^6) from a ciphertext (length 2N * 2^6)
      */
 	const BitVector<N> decrypt(const BitVector<2*N> &x) const{//returns m = D(x) given a ciphertext x
-		const BitVector<2*N> & mix = _M.solve(x);
+		const BitVector<2*N> & mix = _Mi * x;
 		BitVector<N> x1, x2;
 		mix.proj(x1, x2);
 		const BitVector<N> & fx2 = _f(x2);
 		return x1 ^ fx2;
 	}
 
+    /*
+     * Function: encryptBatch(plaintexts, ciphertexts, count)
+     * Encrypts count plaintexts into ciphertexts, which must have room for count vectors
+     * _f is evaluated on all the random vectors with one batch evaluation, then padded
+     * plaintexts are stacked as rows of a block so _M is applied to the whole
+     * block with one matrix product instead of one mat-vec per plaintext
+     */
+	void encryptBatch(const BitVector<N> * plaintexts, BitVector<2*N> * ciphertexts, const unsigned int count) const{
+		vector<BitVector<N> > r(count), fr(count);
+		for (unsigned int j = 0; j < count; ++j) {
+			r[j] = BitVector<N>::randomVector();
+		}
+		if (count > 0) _f.evaluateBatch(&r[0], &fr[0], count);
+		const BitMatrix<2*N> & Mt = _M.transpose();
+		BitMatrix<BATCH_BLOCK_ROWS, 2*N> block = BitMatrix<BATCH_BLOCK_ROWS, 2*N>::zeroMatrix();
+		for (unsigned int start = 0; start < count; start += BATCH_BLOCK_ROWS) {
+			const unsigned int size = min<unsigned int>(BATCH_BLOCK_ROWS, count - start);
+			for (unsigned int j = 0; j < size; ++j) {
+				block[j] = BitVector<N>::vCat(plaintexts[start + j] ^ fr[start + j], r[start + j]);
+			}
+			const BitMatrix<BATCH_BLOCK_ROWS, 2*N> & encryptedBlock = block * Mt;
+			for (unsigned int j = 0; j < size; ++j) {
+				ciphertexts[start + j] = encryptedBlock[j];
+			}
+		}
+	}
+
+    /*
+     * Function: decryptBatch(ciphertexts, plaintexts, count)
+     * Decrypts count ciphertexts into plaintexts, which must have room for count vectors
+     * The inverse of _M is applied to a block of ciphertexts with one matrix product,
+     * then _f is evaluated on all the bottom halves with one batch evaluation
+     */
+	void decryptBatch(const BitVector<2*N> * ciphertexts, BitVector<N> * plaintexts, const unsigned int count) const{
+		vector<BitVector<N> > x2(count);
+		const BitMatrix<2*N> & Mit = _Mi.transpose();
+		BitMatrix<BATCH_BLOCK_ROWS, 2*N> block = BitMatrix<BATCH_BLOCK_ROWS, 2*N>::zeroMatrix();
+		for (unsigned int start = 0; start < count; start += BATCH_BLOCK_ROWS) {
+			const unsigned int size = min<unsigned int>(BATCH_BLOCK_ROWS, count - start);
+			for (unsigned int j = 0; j < size; ++j) {
+				block[j] = ciphertexts[start + j];
+			}
+			const BitMatrix<BATCH_BLOCK_ROWS, 2*N> & mixBlock = block * Mit;
+			for (unsigned int j = 0; j < size; ++j) {
+				mixBlock[j].proj(plaintexts[start + j], x2[start + j]); //top half x1 for now
+			}
+		}
+		if (count > 0) _f.evaluateBatch(&x2[0], &x2[0], count);
+		for (unsigned int j = 0; j < count; ++j) {
+			plaintexts[j] ^= x2[j];
+		}
+	}
+
 protected:
 	const BitMatrix<2*N> getM() const{
 		return _M;
 	}
 
-	const MultiQuadTupleChain<N,2> getf() const{
+	const BitMatrix<2*N> & getMi() const{
+		return _Mi;
+	}
+
+	const MultiQuadTupleChain<N,2> & getf() const{
 		return _f;
 	}
 
@@ -88,6 +148,7 @@ protected:
 
 private:
 	const BitMatrix<2*N> _M; //SL_{2n}(F_2)
+	const BitMatrix<2*N> _Mi; //inverse of _M, computed once so decryption is a single product
 	MultiQuadTupleChain<N,2> _f; //{f_1,...,f_L} random quadratic function tuples
 	BitMatrix<2*N> _Cu[2]; //chain of obfuscation matrix for unary operations
 	BitMatrix<3*N> _Cb[2]; //chain of obfuscation matrix for binary operations
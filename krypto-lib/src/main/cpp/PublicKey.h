@@ -13,8 +13,18 @@
 #define krypto_PublicKey_h
 
 #include "BridgeKey.h"
+#include "PreparedBitMatrix.h"
 
 #define DEBUG false
+#define LMM_BATCH_MIN 32 //smaller batches are cheaper gate by gate than transposing Z
+
+/*
+ * Function: ceilLog2(n)
+ * Returns the number of doubling rounds needed to cover n bits
+ */
+constexpr unsigned int ceilLog2(const unsigned int n) {
+	return n <= 1 ? 0 : 1 + ceilLog2((n + 1) >> 1);
+}
 
 //L will be known by the server anyway (as we pass {f_1',...,f_L'} to it)
 template<unsigned int N>
@@ -24,17 +34,28 @@ public:
 	_ls(bk.getLeftShiftMatrix()),
 	_rs(bk.getRightShiftMatrix()),
 	_lc(bk.getLeftColumnMatrix()),
+	_preparedLs(_ls),
+	_preparedRs(_rs),
+	_preparedLc(_lc),
 	_gu1(bk.getUnaryG1()),
 	_gu2(bk.getUnaryG2()),
 	_XOR(bk.getXOR()),
 	_AND(bk.getAND())
 	{
+		for (unsigned int k = 0; k < ADD_ROUNDS; ++k) {
+			_lsPow[k] = bk.getLeftShiftMatrix(1u << k);
+		}
 	}
 
 	const BitVector<2*N> homomorphicLMM(const BitMatrix<2*N, 4*N> & Z, const BitVector<2*N> &x) const{
 		return Z * BitVector<4*N>::template vCat<2*N, 2*N>(x, _gu2(_gu1(x)));
 	}
 
+	//same as above for a matrix whose column tables are built
+	const BitVector<2*N> homomorphicLMM(const PreparedBitMatrix<2*N, 4*N> & Z, const BitVector<2*N> &x) const{
+		return Z * BitVector<4*N>::template vCat<2*N, 2*N>(x, _gu2(_gu1(x)));
+	}
+
 	const BitVector<2*N> homomorphicXOR(const BitVector<2*N> &x, const BitVector<2*N> &y) const{
 		return _XOR(x, y);
 	}
@@ -45,49 +66,103 @@ public:
 
 	//single left shift (if the leftmost bit of x is nonzero, it'll be zeroed)
 	const BitVector<2*N> homomorphicLEFTSHIFT(const BitVector<2*N> &x) const{
-		return homomorphicLMM(_ls, x);
+		return homomorphicLMM(_preparedLs, x);
 	}
 
 	//single right shift (if the rightmost bit of x is nonzero, it'll be zeroed)
 	const BitVector<2*N> homomorphicRIGHTSHIFT(const BitVector<2*N> &x) const{
-		return homomorphicLMM(_rs, x);
+		return homomorphicLMM(_preparedRs, x);
+	}
+
+	//applies homomorphicLMM(Z, .) to count ciphertexts, stacked as rows of a block so Z
+	//is applied with one matrix product per block
+	void homomorphicLMMBatch(const BitMatrix<2*N, 4*N> & Z, const BitVector<2*N> * x, BitVector<2*N> * result, const unsigned int count) const{
+		if (count < LMM_BATCH_MIN) {
+			for (unsigned int i = 0; i < count; ++i) result[i] = homomorphicLMM(Z, x[i]);
+			return;
+		}
+		const BitMatrix<4*N, 2*N> & Zt = Z.transpose();
+		BitMatrix<BATCH_BLOCK_ROWS, 4*N> block = BitMatrix<BATCH_BLOCK_ROWS, 4*N>::zeroMatrix();
+		for (unsigned int start = 0; start < count; start += BATCH_BLOCK_ROWS) {
+			const unsigned int size = min<unsigned int>(BATCH_BLOCK_ROWS, count - start);
+			for (unsigned int j = 0; j < size; ++j) {
+				block[j] = BitVector<4*N>::template vCat<2*N, 2*N>(x[start + j], _gu2(_gu1(x[start + j])));
+			}
+			const BitMatrix<BATCH_BLOCK_ROWS, 2*N> & products = block * Zt;
+			for (unsigned int j = 0; j < size; ++j) result[start + j] = products[j];
+		}
+	}
+
+	void homomorphicLEFTSHIFTBatch(const BitVector<2*N> * x, BitVector<2*N> * result, const unsigned int count) const{
+		homomorphicLMMBatch(_ls, x, result, count);
+	}
+
+	void homomorphicRIGHTSHIFTBatch(const BitVector<2*N> * x, BitVector<2*N> * result, const unsigned int count) const{
+		homomorphicLMMBatch(_rs, x, result, count);
 	}
 
 	//add with carry over (aka integer addition in base 2)
+	//carries are resolved by a Kogge-Stone prefix: ceil(log2 N) rounds of independent gates
 	const BitVector<2*N> homomorphicADD(const BitVector<2*N> &x, const BitVector<2*N> &y) const{
-		BitVector<2*N> currentLHS = x;
-		BitVector<2*N> currentRHS = y;
-		BitVector<2*N> sum = homomorphicXOR(currentLHS, currentRHS);
-		BitVector<2*N> carry = homomorphicAND(currentLHS, currentRHS);
-		for(int i = 1; i < N; ++i){
-			currentLHS = sum;
-			currentRHS = homomorphicLEFTSHIFT(carry);
-			sum = homomorphicXOR(currentLHS, currentRHS);
-			carry = homomorphicAND(currentLHS, currentRHS);
+		const BitVector<2*N> & sum = homomorphicXOR(x, y);
+		BitVector<2*N> generate = homomorphicAND(x, y);
+		BitVector<2*N> propagate = sum;
+		for (unsigned int k = 0; k < ADD_ROUNDS; ++k) {
+			const BitVector<2*N> & shiftedGenerate = homomorphicLMM(_lsPow[k], generate);
+			const BitVector<2*N> & shiftedPropagate = homomorphicLMM(_lsPow[k], propagate);
+			//generate and propagate & shiftedGenerate never overlap, so XOR acts as OR
+			generate = homomorphicXOR(generate, homomorphicAND(propagate, shiftedGenerate));
+			propagate = homomorphicAND(propagate, shiftedPropagate);
 		}
-		return sum;
+		return homomorphicXOR(sum, homomorphicLEFTSHIFT(generate));
 	}
 
-	//integer multiplication in base 2 (inputs should be < N bits)
+	//integer multiplication in base 2 (modulo 2^N)
+	//the N partial products are independent; a Wallace tree of carry-save adders reduces them
+	//to two addends in O(log N) levels, which a single homomorphicADD then sums
 	const BitVector<2*N> homomorphicMULT(const BitVector<2*N> &x, const BitVector<2*N> &y) const{
-		BitVector<2*N> shiftedX = x;
-		BitVector<2*N> result = homomorphicAND(homomorphicLMM(_lc, shiftedX), y);
-		for(int i = 1; i < N; ++i){
-			result = homomorphicLEFTSHIFT(result);
-			shiftedX = homomorphicLEFTSHIFT(shiftedX);
-			result = homomorphicADD(result, homomorphicAND(homomorphicLMM(_lc, shiftedX), y));
+		vector<BitVector<2*N> > shiftedX(N), shiftedY(N);
+		shiftedX[0] = x;
+		shiftedY[0] = y;
+		for (unsigned int i = 1; i < N; ++i) { //shift by i from the shift by i without its lowest set bit
+			const unsigned int k = __builtin_ctz(i);
+			shiftedX[i] = homomorphicLMM(_lsPow[k], shiftedX[i - (1u << k)]);
+			shiftedY[i] = homomorphicLMM(_lsPow[k], shiftedY[i - (1u << k)]);
+		}
+
+		vector<BitVector<2*N> > terms(N);
+		for (unsigned int i = 0; i < N; ++i) { //bit i of x weighs 2^(N-1-i)
+			terms[i] = homomorphicAND(homomorphicLMM(_preparedLc, shiftedX[i]), shiftedY[N - 1 - i]);
+		}
+
+		while (terms.size() > 2) {
+			vector<BitVector<2*N> > next;
+			unsigned int i = 0;
+			for (; i + 3 <= terms.size(); i += 3) { //a + b + c = (a ^ b ^ c) + 2 * majority(a, b, c)
+				const BitVector<2*N> & ab = homomorphicXOR(terms[i], terms[i + 1]);
+				next.push_back(homomorphicXOR(ab, terms[i + 2]));
+				const BitVector<2*N> & majority = homomorphicXOR(homomorphicAND(terms[i], terms[i + 1]), homomorphicAND(ab, terms[i + 2]));
+				next.push_back(homomorphicLEFTSHIFT(majority));
+			}
+			for (; i < terms.size(); ++i) next.push_back(terms[i]);
+			terms.swap(next);
 		}
-		return result;
+		return terms.size() == 1 ? terms[0] : homomorphicADD(terms[0], terms[1]);
 	}
 
 private:
 	const BitMatrix<2*N, 4*N> _ls;
 	const BitMatrix<2*N, 4*N> _rs;
 	const BitMatrix<2*N, 4*N> _lc;
+	const PreparedBitMatrix<2*N, 4*N> _preparedLs; //column tables of the three matrices above
+	const PreparedBitMatrix<2*N, 4*N> _preparedRs;
+	const PreparedBitMatrix<2*N, 4*N> _preparedLc;
 	const MultiQuadTuple<2*N, 2*N> _gu1;
 	const MultiQuadTuple<2*N, 2*N> _gu2;
 	typename BridgeKey<N>::H_XOR _XOR;
 	typename BridgeKey<N>::H_AND _AND;
+	static const unsigned int ADD_ROUNDS = ceilLog2(N);
+	BitMatrix<2*N, 4*N> _lsPow[ADD_ROUNDS > 0 ? ADD_ROUNDS : 1]; //_lsPow[k] shifts left by 2^k
 };
 
 #endif
\ No newline at end of file
@@ -29,7 +29,9 @@ class SearchPrivateKey{
 public:
   SearchPrivateKey() :
   _K(BitMatrix<N>::randomInvertibleMatrix()),
-  _R(BitMatrix<N>::randomInvertibleMatrix())
+  _R(BitMatrix<N>::randomInvertibleMatrix()),
+  _Ki(_K.inv()),
+  _Ri(_R.inv())
   {}
 
   /* Getters */
@@ -66,7 +68,7 @@ public:
    * Equation: L_{doc} * K_{user}^{-1}
    */
   const BitMatrix<N> getObjectConversionMatrix(const BitMatrix<N> & objectAddressMatrix) const {
-    return objectAddressMatrix * _K.inv();
+    return objectAddressMatrix * _Ki;
   }
 
   /*
@@ -132,12 +134,14 @@ public:
    * Equation: {R_{recipient}^{-1} * R_{sender} * d_{doc}, L_{doc} * K_{recipient}^{-1}}
    */
   const std::pair<BitVector<2*N>, BitMatrix<N>> getObjectSearchPairFromObjectSharePair(const std::pair<BitVector<N>, BitMatrix<N>> & objectSharePair, const PrivateKey<N> & pk) const {
-    return std::make_pair(pk.encrypt(_R.solve(objectSharePair.first)), getObjectConversionMatrix(objectSharePair.second));
+    return std::make_pair(pk.encrypt(_Ri * objectSharePair.first), getObjectConversionMatrix(objectSharePair.second));
   }
 
 private:
   BitMatrix<N> _K; // user-specific front protection
   BitMatrix<N> _R; // user-specific hash auxiliary matrix
+  BitMatrix<N> _Ki; // inverse of _K, kept so converting an object is a single product
+  BitMatrix<N> _Ri; // inverse of _R, kept so receiving a share is a single mat-vec
 };
 
 #endif/* defined(__krypto__SearchPrivateKey__) */
@@ -7,7 +7,8 @@
 
 #include "../../../contrib/gtest/gtest.h"
 #include "../../main/cpp/BitVector.h"
-#include "../../main/cpp/BitMatrix.h"
+#include "../../main/cpp/PreparedBitMatrix.h"
+#include "../../main/cpp/HeapBitMatrix.h"
 #include <string>
 using namespace testing;
 
@@ -156,4 +157,144 @@ TEST(BitMatrixTests, testTranspose){
 	BitMatrix<N,2*N> Rtt = Rt.transpose();
 	ASSERT_TRUE(R.equals(Rtt));
 	ASSERT_TRUE(Rtt.equals(R));
-}
\ No newline at end of file
+}
+TEST(BitMatrixTests, testM4RMMult){
+	BitMatrix<2*N, 3*N> A = BitMatrix<2*N, 3*N>::randomMatrix();
+	BitMatrix<3*N, N> B = BitMatrix<3*N, N>::randomMatrix();
+	BitMatrix<2*N, N> expected = A.naiveMult<N>(B);
+	ASSERT_TRUE(A.m4rmMult<N>(B).equals(expected));
+	ASSERT_TRUE((A * B).equals(expected));
+
+	BitMatrix<N, 100> C = BitMatrix<N, 100>::randomMatrix(); //last chunk is only 4 rows wide
+	BitMatrix<100, 2*N> D = BitMatrix<100, 2*N>::randomMatrix();
+	ASSERT_TRUE(C.m4rmMult<2*N>(D).equals(C.naiveMult<2*N>(D)));
+}
+
+TEST(BitMatrixTests, testHeapBitMatrix){
+	HeapBitMatrix<4*N, N> A;
+	ASSERT_TRUE(A->equals(BitMatrix<4*N, N>::zeroMatrix()));
+	*A = BitMatrix<4*N, N>::randomMatrix();
+
+	HeapBitMatrix<4*N, N> B(A); //deep copy
+	ASSERT_TRUE(B->equals(*A));
+	B->set(0, 0, !A->get(0, 0));
+	ASSERT_FALSE(B->equals(*A));
+
+	const BitMatrix<4*N, N> expected = *A;
+	HeapBitMatrix<4*N, N> C(std::move(A));
+	ASSERT_TRUE(A.isEmpty());
+	ASSERT_TRUE(C->equals(expected));
+
+	A = C; //copy into an emptied matrix
+	ASSERT_FALSE(A.isEmpty());
+	ASSERT_TRUE(A->equals(expected));
+}
+
+TEST(BitMatrixTests, testWideRows){
+    //rows of 1024 bits go through the SIMD kernels; a whole number of words, so no padding bits enter the dot products
+    BitMatrix<40, 1024> A = BitMatrix<40, 1024>::randomMatrix();
+    BitMatrix<40, 1024> B = BitMatrix<40, 1024>::randomMatrix();
+    BitVector<1024> v = BitVector<1024>::randomVector();
+    BitVector<40> Av = A * v;
+    for (unsigned int i = 0; i < 40; ++i) {
+        bool dot = false;
+        for (unsigned int j = 0; j < 1024; ++j) dot ^= A.get(i, j) && v[j];
+        ASSERT_EQ(dot, Av[i]);
+    }
+    BitMatrix<40, 1024> C = A ^ B;
+    ASSERT_FALSE(C.isZero());
+    ASSERT_TRUE((C ^ A).equals(B));
+    ASSERT_TRUE((C ^ C).isZero());
+    ASSERT_TRUE((BitMatrix<40, 1024>::zeroMatrix()).isZero());
+}
+
+TEST(BitMatrixTests, testMatVec){
+    //row count not a multiple of 4 exercises the tail after the 4-row passes
+    BitMatrix<71, 192> A = BitMatrix<71, 192>::randomMatrix();
+    BitVector<192> v = BitVector<192>::randomVector();
+    BitVector<71> Av = A * v;
+    for (unsigned int i = 0; i < 71; ++i) {
+        ASSERT_EQ(A[i].dot(v), Av[i]);
+    }
+    BitMatrix<128> B = BitMatrix<128>::randomInvertibleMatrix();
+    BitVector<128> b = BitVector<128>::randomVector();
+    ASSERT_TRUE((B * B.solve(b)).equals(b));
+}
+
+TEST(BitMatrixTests, testPreparedMatVec){
+    BitMatrix<100, 203> A = BitMatrix<100, 203>::randomMatrix();
+    PreparedBitMatrix<100, 203> preparedA(A);
+    BitMatrix<256, 512> B = BitMatrix<256, 512>::randomMatrix();
+    PreparedBitMatrix<256, 512> preparedB(B);
+    for (int k = 0; k < 20; ++k) {
+        BitVector<203> x = BitVector<203>::zeroVector(); //no bits past 203, which A * x would count
+        for (unsigned int i = 0; i < 203; ++i) x.set(i, RandomGenerator::local().nextInt() & 1);
+        ASSERT_TRUE((preparedA * x).equals(A * x));
+        BitVector<512> y = BitVector<512>::randomVector();
+        ASSERT_TRUE((preparedB * y).equals(B * y));
+    }
+}
+
+TEST(BitMatrixTests, testBlockTranspose){
+    BitMatrix<100, 200> A = BitMatrix<100, 200>::randomMatrix();
+    BitMatrix<200, 100> At = A.transpose();
+    BitMatrix<200, 70> Bt = A.trimAndTranpose<30>();
+    for (unsigned int i = 0; i < 100; ++i) {
+        for (unsigned int j = 0; j < 200; ++j) {
+            ASSERT_EQ(A.get(i, j), At.get(j, i));
+            if (i >= 30) ASSERT_EQ(A.get(i, j), Bt.get(j, i - 30));
+        }
+    }
+    for (unsigned int j = 0; j < 200; j += 13) {
+        ASSERT_TRUE(A.getCol(j).equals(At[j]));
+    }
+    ASSERT_TRUE(At.transpose().transpose().equals(At)); //bits past 100 in the rows of At are clean
+}
+
+TEST(BitMatrixTests, testM4RI){
+    //compares against the elimination one column at a time, on full rank and rank deficient matrices
+    BitMatrix<128, 192> A = BitMatrix<128, 192>::randomMatrix();
+    ASSERT_TRUE(A.rref().equals(A.naiveRref()));
+    for (unsigned int i = 64; i < 128; ++i) A[i] = A[i - 64] ^ A[i - 63];
+    ASSERT_TRUE(A.rref().equals(A.naiveRref()));
+    BitMatrix<256> M = BitMatrix<256>::randomInvertibleMatrix();
+    BitMatrix<256> Mi = BitMatrix<256>::identityMatrix();
+    M.naiveRref(Mi);
+    bool invertible = false;
+    ASSERT_TRUE(M.inv(invertible).equals(Mi));
+    ASSERT_TRUE(invertible);
+    BitVector<256> b = BitVector<256>::randomVector();
+    bool solvable = false;
+    ASSERT_TRUE(M.solve(b, solvable).equals(M.naiveSolve(b, solvable)));
+    M[255] = M[0] ^ M[1];
+    M.inv(invertible);
+    ASSERT_FALSE(invertible);
+}
+
+TEST(BitMatrixTests, testRandomInvertibleDistribution){
+    //each of the 168 invertible 3x3 matrices should come up about equally often
+    const unsigned int samplesPerMatrix = 100;
+    vector<unsigned int> counts(512, 0);
+    for (unsigned int s = 0; s < 168 * samplesPerMatrix; ++s) {
+        BitMatrix<3> M = BitMatrix<3>::randomInvertibleMatrix();
+        unsigned int index = 0;
+        for (unsigned int i = 0; i < 3; ++i) {
+            for (unsigned int j = 0; j < 3; ++j) index = (index << 1) | M.get(i, j);
+        }
+        ++counts[index];
+    }
+    unsigned int distinct = 0;
+    double chiSquare = 0;
+    for (unsigned int k = 0; k < 512; ++k) {
+        if (counts[k] == 0) continue;
+        ++distinct;
+        const double deviation = counts[k] - (double) samplesPerMatrix;
+        chiSquare += deviation * deviation / samplesPerMatrix;
+    }
+    ASSERT_EQ(168, distinct);
+    ASSERT_LT(chiSquare, 300); //167 degrees of freedom, so 300 is about 7 standard deviations out
+
+    bool invertible = false;
+    BitMatrix<256>::randomInvertibleMatrix().inv(invertible);
+    ASSERT_TRUE(invertible);
+}
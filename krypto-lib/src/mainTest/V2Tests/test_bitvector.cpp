@@ -124,4 +124,118 @@ TEST(BitVectorTests, test_mult) {
     BitVector<64> sum = x * y;
     sum.print(); 
     ASSERT_TRUE(true);
-}
\ No newline at end of file
+}
+//reads a BitVector<64> as an integer, index 0 being the most significant bit
+static unsigned long long toInteger(const BitVector<64> & v) {
+    unsigned long long val = 0;
+    for (int i = 0; i < 64; ++i) val = (val << 1) | v.get(i);
+    return val;
+}
+
+TEST(BitVectorTests, test_shift_words) {
+    BitVector<130> v = BitVector<130>::randomVector();
+    unsigned int amounts[] = {0, 1, 5, 63, 64, 65, 127, 129, 130};
+    for (unsigned int k = 0; k < sizeof(amounts) / sizeof(amounts[0]); ++k) {
+        unsigned int n = amounts[k];
+        BitVector<130> l = v.leftShift(n);
+        BitVector<130> r = v.rightShift(n);
+        BitVector<130> expectedL = BitVector<130>::zeroVector();
+        BitVector<130> expectedR = BitVector<130>::zeroVector();
+        for (unsigned int i = 0; i + n < 130; ++i) {
+            expectedL.set(i, v.get(i + n));
+            expectedR.set(i + n, v.get(i));
+        }
+        ASSERT_TRUE(l.equals(expectedL));
+        ASSERT_TRUE(r.equals(expectedR));
+    }
+}
+
+TEST(BitVectorTests, test_add_mult_integer) {
+    for (int k = 0; k < 100; ++k) {
+        BitVector<64> x = BitVector<64>::randomVector();
+        BitVector<64> y = BitVector<64>::randomVector();
+        ASSERT_EQ(toInteger(x) + toInteger(y), toInteger(x + y));
+        ASSERT_EQ(toInteger(x) * toInteger(y), toInteger(x * y));
+    }
+}
+
+TEST(BitVectorTests, test_random_keystream) {
+    //RFC 7539 A.1 test vectors 1 and 2: zero key and nonce, blocks 0 and 1
+    const unsigned char block0[16] = {0x76, 0xb8, 0xe0, 0xad, 0xa0, 0xf1, 0x3d, 0x90, 0x40, 0x5d, 0x6a, 0xe5, 0x53, 0x86, 0xbd, 0x28};
+    const unsigned char block1[16] = {0x9f, 0x07, 0xe7, 0xbe, 0x55, 0x51, 0x38, 0x7a, 0x98, 0xba, 0x97, 0x7c, 0x73, 0x2d, 0x08, 0x0d};
+    unsigned char out[80];
+    RandomGenerator generator;
+    generator.seed(0ull);
+    generator.fill(out, sizeof(out));
+    ASSERT_EQ(0, memcmp(out, block0, 16));
+    ASSERT_EQ(0, memcmp(out + 64, block1, 16));
+}
+
+TEST(BitVectorTests, test_random_seed) {
+    RandomGenerator::local().seed(2016ull);
+    BitVector<200> first = BitVector<200>::randomVector();
+    RandomGenerator::local().seed(2016ull);
+    BitVector<200> second = BitVector<200>::randomVector();
+    RandomGenerator::local().reseed();
+    BitVector<200> third = BitVector<200>::randomVector();
+    ASSERT_TRUE(first.equals(second));
+    ASSERT_FALSE(first.equals(third));
+}
+
+TEST(BitVectorTests, test_simd_kernels) {
+    //every level the host supports must agree with the portable kernels, tails included
+    const SimdKernels & reference = SimdKernels::forLevel(SIMD_PORTABLE);
+    const SimdLevel levels[] = {SIMD_SSE2, SIMD_AVX2, SIMD_AVX512};
+    for (unsigned int l = 0; l < 3; ++l) {
+        if (!SimdKernels::supported(levels[l])) continue;
+        const SimdKernels & kernels = SimdKernels::forLevel(levels[l]);
+        for (unsigned int n = 0; n < 20; ++n) {
+            BitVector<20 * 64> a = BitVector<20 * 64>::randomVector();
+            BitVector<20 * 64> b = BitVector<20 * 64>::randomVector();
+            unsigned long long expected[20], actual[20];
+            reference.xorWords(expected, a.elements(), b.elements(), n);
+            kernels.xorWords(actual, a.elements(), b.elements(), n);
+            ASSERT_EQ(0, memcmp(expected, actual, n * sizeof(unsigned long long)));
+            reference.andWords(expected, a.elements(), b.elements(), n);
+            kernels.andWords(actual, a.elements(), b.elements(), n);
+            ASSERT_EQ(0, memcmp(expected, actual, n * sizeof(unsigned long long)));
+            kernels.xorInto(actual, a.elements(), n);
+            reference.xorInto(expected, a.elements(), n);
+            ASSERT_EQ(0, memcmp(expected, actual, n * sizeof(unsigned long long)));
+            ASSERT_EQ(reference.parity(a.elements(), n), kernels.parity(a.elements(), n));
+            ASSERT_EQ(reference.andParity(a.elements(), b.elements(), n), kernels.andParity(a.elements(), b.elements(), n));
+            ASSERT_EQ(reference.popcount(a.elements(), n), kernels.popcount(a.elements(), n));
+            ASSERT_TRUE(kernels.isZero(BitVector<20 * 64>::zeroVector().elements(), n));
+            ASSERT_EQ(n == 0, kernels.isZero(a.elements(), n)); //a random word is never zero in practice
+        }
+    }
+
+    //vectors wide enough to go through the dispatch table
+    BitVector<1000> x = BitVector<1000>::randomVector();
+    BitVector<1000> y = BitVector<1000>::randomVector();
+    BitVector<1000> sum = x ^ y;
+    BitVector<1000> product = x & y;
+    for (unsigned int i = 0; i < 1000; ++i) {
+        ASSERT_EQ(x[i] != y[i], sum[i]);
+        ASSERT_EQ(x[i] && y[i], product[i]);
+    }
+    sum ^= x;
+    ASSERT_TRUE(sum.equals(y));
+    sum ^= y;
+    ASSERT_TRUE(sum.isZero());
+}
+
+TEST(BitVectorTests, test_dot) {
+    //bits past NUM_BITS must not count, whatever randomVector left there
+    for (int k = 0; k < 50; ++k) {
+        BitVector<100> x = BitVector<100>::randomVector();
+        BitVector<100> y = BitVector<100>::randomVector();
+        BitVector<1000> u = BitVector<1000>::randomVector();
+        BitVector<1000> v = BitVector<1000>::randomVector();
+        bool expectedXY = false, expectedUV = false;
+        for (unsigned int i = 0; i < 100; ++i) expectedXY ^= x[i] && y[i];
+        for (unsigned int i = 0; i < 1000; ++i) expectedUV ^= u[i] && v[i];
+        ASSERT_EQ(expectedXY, x.dot(y));
+        ASSERT_EQ(expectedUV, u.dot(v));
+    }
+}
@@ -10,6 +10,49 @@ using namespace testing;
 #define sma 64
 #define mon 7
 
+TEST(MonomialMatrixChainTests, testAppendAndCopy) {
+	MonomialMatrixChain<sma,sma> f = MonomialMatrixChain<sma,sma>::random();
+	const unsigned int first = f.length();
+	for (int k = 0; k < 100; ++k) f.append(BitMatrix<sma>::randomMatrix());
+	ASSERT_EQ(first + 100, f.length());
+
+	BitVector<sma> x = BitVector<sma>::randomVector();
+	BitVector<sma> sum = BitVector<sma>::zeroVector();
+	for (unsigned int k = 0; k < f.length(); ++k) {
+		MonomialMatrixChain<sma,sma> single;
+		single.SetMonomialMatrix(f.getMonomialMatrix(k));
+		sum ^= single(x);
+	}
+	ASSERT_TRUE(f(x).equals(sum));
+
+	MonomialMatrixChain<sma,sma> g = f;
+	g.SetMonomialMatrix(BitMatrix<sma>::zeroMatrix());
+	ASSERT_TRUE(f(x).equals(sum));
+	ASSERT_TRUE(f.getMonomialMatrix(1) == g.getMonomialMatrix(1));
+
+	MonomialMatrixChain<sma,sma> h = std::move(g);
+	ASSERT_EQ(f.length(), h.length());
+}
+
+TEST(MonomialMatrixChainTests, testEvaluationKernel) {
+	MonomialMatrixChain<3*sma,2*sma> f = MonomialMatrixChain<3*sma,2*sma>::random();
+	for (int k = 0; k < 10; ++k) {
+		BitMatrix<3*sma,2*sma> dense = BitMatrix<3*sma,2*sma>::randomMatrix() | BitMatrix<3*sma,2*sma>::randomMatrix() | BitMatrix<3*sma,2*sma>::randomMatrix();
+		f.append(dense); //products that stay nonzero for a while
+	}
+	const unsigned int count = 50;
+	BitVector<3*sma> x[count];
+	BitVector<2*sma> y[count];
+	for (unsigned int j = 0; j < count; ++j) x[j] = BitVector<3*sma>::randomVector();
+	x[0] = BitVector<3*sma>::allOneVector();
+	x[1] = BitVector<3*sma>::zeroVector();
+	f.evaluateBatch(x, y, count);
+	for (unsigned int j = 0; j < count; ++j) {
+		ASSERT_TRUE(f(x[j]).equals(f.naiveEvaluate(x[j])));
+		ASSERT_TRUE(y[j].equals(f(x[j])));
+	}
+}
+
 TEST(ConstantChainHeaderTests, testPartialEval) {
 	ConstantChainHeader<2*sma,sma> f = ConstantChainHeader<2*sma,sma>::random();
 
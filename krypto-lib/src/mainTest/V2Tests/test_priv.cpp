@@ -27,4 +27,18 @@ TEST(PrivKeyTests, testEncryptionAndDecryption){
 	std::cout << "Total time for decryption: " << total << " ns" << std::endl;
 
 	ASSERT_TRUE(m.equals(mt));
-}
\ No newline at end of file
+}
+
+TEST(PrivKeyTests, testBatchEncryptionAndDecryption){
+	PrivateKey<N,MON> pk;
+	const unsigned int count = 300; //spans more than one block
+	BitVector<N> m[count], mt[count];
+	BitVector<2*N> c[count];
+	for (unsigned int i = 0; i < count; ++i) m[i] = BitVector<N>::randomVector();
+	pk.encryptBatch(m, c, count);
+	pk.decryptBatch(c, mt, count);
+	for (unsigned int i = 0; i < count; ++i) {
+		ASSERT_TRUE(m[i].equals(pk.decrypt(c[i])));
+		ASSERT_TRUE(m[i].equals(mt[i]));
+	}
+}
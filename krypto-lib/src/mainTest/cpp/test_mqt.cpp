@@ -1,5 +1,5 @@
 #include "../../../contrib/gtest/gtest.h"
-#include "../../main/cpp/MultiQuadTuple.h"
+#include "../../main/cpp/BitSlicedMultiQuadTuple.h"
 #include <string>
 #include <ctime>
 #include <chrono>
@@ -50,6 +50,21 @@ TEST(MQTTests, testLeftComposeDiffDims){
     ASSERT_TRUE(csm_v.equals(cs_mv));
 }
 
+TEST(MQTTests, testLeftComposeMatchesNaive){
+    BitMatrix<70,150> m = BitMatrix<70,150>::randomMatrix();
+    MultiQuadTuple<70,mid> cs;
+    cs.randomize();
+    MultiQuadTuple<150,mid> fast = cs * m;
+    MultiQuadTuple<150,mid> naive = cs.naiveCompose(m);
+    vector<BitVector<mid> > fastRows(((150 * 151) >> 1) + 1);
+    vector<BitVector<mid> > naiveRows(((150 * 151) >> 1) + 1);
+    fast.flatten(&fastRows[0]);
+    naive.flatten(&naiveRows[0]);
+    for (unsigned int r = 0; r < fastRows.size(); ++r) {
+        ASSERT_TRUE(fastRows[r].equals(naiveRows[r]));
+    }
+}
+
 TEST(MQTTests, testRightCompose){
     BitVector<sma> v = BitVector<sma>::randomVector();
     MultiQuadTuple<sma,sma> cs;
@@ -117,6 +132,64 @@ TEST(MQTTests, testPartialEval){
     ASSERT_TRUE(g(y) == f(z));
 }
 
+TEST(MQTTests, testFlatPartialEval){
+    MultiQuadTuple<150,mid> f;
+    f.randomize();
+    BitVector<75> x = BitVector<75>::randomVector();
+    FlatMultiQuadTuple<75,mid> flatG = FlatMultiQuadTuple<150,mid>(f).partialEval<75>(x);
+    MultiQuadTuple<75,mid> g = f.partialEval<75>(x);
+    ASSERT_TRUE(flatG.equals(FlatMultiQuadTuple<75,mid>(g)));
+
+    BitVector<75> y = BitVector<75>::randomVector();
+    BitVector<150> z = BitVector<150>::zeroVector();
+    for (unsigned int i = 0; i < 75; ++i) if (x[i]) z.set(i);
+    for (unsigned int i = 0; i < 75; ++i) if (y[i]) z.set(75 + i);
+    ASSERT_TRUE(flatG(y).equals(f(z)));
+}
+
+TEST(MQTTests, testFlatLayout){
+    MultiQuadTuple<100,70> f;
+    f.randomize();
+    typedef FlatMultiQuadTuple<100,70> Flat;
+    Flat flat(f);
+    ASSERT_TRUE(flat.getConstants().equals(f.getConstants()));
+    ASSERT_TRUE(flat[Flat::monomialIndex(3, 7)].equals(f.getMatrix(BitVector<97>())[4]));
+
+    for (unsigned int k = 0; k < 20; ++k) {
+        BitVector<100> x = BitVector<100>::randomVector();
+        ASSERT_TRUE(flat(x).equals(f(x)));
+    }
+
+    MultiQuadTuple<100,70> g;
+    flat.toMQT(g);
+    Flat roundTrip(g);
+    ASSERT_TRUE(roundTrip.equals(flat));
+
+    Flat moved(std::move(roundTrip));
+    ASSERT_TRUE(moved.equals(flat));
+    ASSERT_TRUE(Flat().getConstants().isZero());
+}
+
+TEST(MQTTests, testBitSlicedBatch){
+    MultiQuadTuple<100,70> f;
+    f.randomize();
+    BitSlicedMultiQuadTuple<100,70> sliced(f);
+
+    const unsigned int count = SLICE_LANES + 44; //second block only partially filled
+    std::vector<BitVector<100> > inputs(count);
+    for (unsigned int k = 0; k < count; ++k) {
+        inputs[k] = BitVector<100>::randomVector();
+    }
+    std::vector<BitVector<70> > outputs(count);
+    sliced.evaluateBatch(&inputs[0], &outputs[0], count);
+    for (unsigned int k = 0; k < count; ++k) {
+        const BitVector<70> & expected = f(inputs[k]);
+        for (unsigned int o = 0; o < 70; ++o) { //random rows may carry garbage past bit 70
+            ASSERT_EQ(expected.get(o), outputs[k].get(o));
+        }
+    }
+}
+
 /*
 TODO: implement this with the recursive struct
 TEST(MQTTests, testShifter){
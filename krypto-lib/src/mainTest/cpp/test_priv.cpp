@@ -12,4 +12,36 @@ TEST(PrivKeyTests, testEncryptionAndDecryption){
 	BitVector<2*N> c = pk.encrypt(m);
 	BitVector<N> mt = pk.decrypt(c);
 	ASSERT_TRUE(m.equals(mt));
-}
\ No newline at end of file
+}
+
+TEST(PrivKeyTests, testBatchEncryptionAndDecryption){
+	PrivateKey<N> pk;
+	const unsigned int count = 300; //spans more than one block
+	BitVector<N> m[count], mt[count];
+	BitVector<2*N> c[count];
+	for (unsigned int i = 0; i < count; ++i) m[i] = BitVector<N>::randomVector();
+	pk.encryptBatch(m, c, count);
+	pk.decryptBatch(c, mt, count);
+	for (unsigned int i = 0; i < count; ++i) {
+		ASSERT_TRUE(m[i].equals(pk.decrypt(c[i])));
+		ASSERT_TRUE(m[i].equals(mt[i]));
+	}
+}
+
+TEST(PrivKeyTests, testChainBatchEvaluation){
+	const MultiQuadTupleChain<N,2> & f = MultiQuadTupleChain<N,2>::randomMultiQuadTupleChain();
+	const unsigned int counts[3] = {5, 100, 600}; //per input, flat and bit-sliced stages
+	for (unsigned int t = 0; t < 3; ++t) {
+		const unsigned int count = counts[t];
+		vector<BitVector<N> > x(count), y(count);
+		for (unsigned int i = 0; i < count; ++i) x[i] = BitVector<N>::randomVector();
+		f.evaluateBatch(&x[0], &y[0], count);
+		for (unsigned int i = 0; i < count; ++i) {
+			ASSERT_TRUE(y[i].equals(f(x[i])));
+		}
+		f.evaluateBatch(&x[0], &x[0], count); //in place
+		for (unsigned int i = 0; i < count; ++i) {
+			ASSERT_TRUE(x[i].equals(y[i]));
+		}
+	}
+}
@@ -7,6 +7,7 @@
 
 #include "../../../contrib/gtest/gtest.h"
 #include "../../main/cpp/PublicKey.h"
+#include "../../main/cpp/HomomorphicCircuit.h"
 #include <time.h>
 
 using namespace testing;
@@ -137,6 +138,16 @@ TEST(PublicKeyTest, testADD){
 	ASSERT_TRUE(actualSum.equals(expectedSum)); 
 }
 
+TEST(PublicKeyTest, testADDWithOverflow){
+	PrivateKey<N> pk;
+	BridgeKey<N> bk(pk);
+	PublicKey<N> pub(bk);
+	BitVector<N> x = BitVector<N>::randomVector();
+	BitVector<N> y = BitVector<N>::randomVector();
+	BitVector<2*N> encryptedSum = pub.homomorphicADD(pk.encrypt(x), pk.encrypt(y));
+	ASSERT_TRUE(pk.decrypt(encryptedSum).equals(x + y)); //sum modulo 2^N
+}
+
 TEST(PublicKeyTest, testMULT){
 	PrivateKey<N> pk;
 	BridgeKey<N> bk(pk);
@@ -149,4 +160,63 @@ TEST(PublicKeyTest, testMULT){
 	BitVector<N> actualProd = pk.decrypt(encryptedProd);
 	BitVector<N> expectedProd = x * y;
 	ASSERT_TRUE(actualProd.equals(expectedProd));
-}
\ No newline at end of file
+}
+
+TEST(PublicKeyTest, testCircuit){
+	PrivateKey<N> pk;
+	BridgeKey<N> bk(pk);
+	PublicKey<N> pub(bk);
+	BitVector<N> x = BitVector<N>::randomVector();
+	BitVector<N> y = BitVector<N>::randomVector();
+	BitMatrix<N> K = BitMatrix<N>::randomMatrix();
+
+	HomomorphicCircuit<N> circuit;
+	const unsigned int a = circuit.input();
+	const unsigned int b = circuit.input();
+	const unsigned int sum = circuit.XOR(a, b);
+	ASSERT_EQ(sum, circuit.XOR(b, a)); //shared subexpression
+	const unsigned int carry = circuit.LEFTSHIFT(circuit.AND(a, b));
+	const unsigned int mixed = circuit.XOR(sum, carry);
+	const unsigned int product = circuit.LMM(bk.getLMMZ(K), mixed);
+	const unsigned int shifted = circuit.RIGHTSHIFT(b);
+	ASSERT_EQ(8, circuit.size());
+
+	vector<BitVector<2*N> > inputs;
+	inputs.push_back(pk.encrypt(x));
+	inputs.push_back(pk.encrypt(y));
+	vector<unsigned int> outputs;
+	outputs.push_back(mixed);
+	outputs.push_back(product);
+	outputs.push_back(shifted);
+
+	ThreadPool pool(4);
+	const vector<BitVector<2*N> > & parallel = circuit.evaluate(pub, inputs, outputs, pool);
+	const vector<BitVector<2*N> > & serial = circuit.evaluate(pub, inputs, outputs);
+	const BitVector<N> & expectedMixed = (x ^ y) ^ (x & y).leftShift();
+	for (unsigned int i = 0; i < 2; ++i) {
+		const vector<BitVector<2*N> > & values = i ? serial : parallel;
+		ASSERT_TRUE(pk.decrypt(values[0]).equals(expectedMixed));
+		ASSERT_TRUE(pk.decrypt(values[1]).equals(K * expectedMixed));
+		ASSERT_TRUE(pk.decrypt(values[2]).equals(y.rightShift()));
+	}
+}
+
+TEST(PublicKeyTest, testLMMBatch){
+	PrivateKey<N> pk;
+	BridgeKey<N> bk(pk);
+	PublicKey<N> pub(bk);
+	BitMatrix<N> K = BitMatrix<N>::randomMatrix();
+	BitMatrix<2*N, 4*N> Z = bk.getLMMZ(K);
+
+	const unsigned int count = 2 * LMM_BATCH_MIN;
+	BitVector<N> x[count];
+	BitVector<2*N> encryptedX[count], encryptedLMM[count];
+	for (unsigned int i = 0; i < count; ++i) {
+		x[i] = BitVector<N>::randomVector();
+		encryptedX[i] = pk.encrypt(x[i]);
+	}
+	pub.homomorphicLMMBatch(Z, encryptedX, encryptedLMM, count);
+	for (unsigned int i = 0; i < count; ++i) {
+		ASSERT_TRUE(pk.decrypt(encryptedLMM[i]).equals(K * x[i]));
+	}
+}
@@ -33,4 +33,43 @@ TEST(KryptnosticServerTest, testInit){
 	BitVector<> actualAddress = ks.getMetadataAddress(objectSearchPair);
 
 	ASSERT_TRUE(expectedAddress.equals(actualAddress));
-}
\ No newline at end of file
+}
+
+TEST(KryptnosticServerTest, testBatchAddresses){
+	SearchPrivateKey<> sk;
+	PrivateKey<> pk;
+	ClientHashFunction<> chf = sk.getClientHashFunction(pk);
+	KryptnosticServer<> ks(chf, pk.encrypt(BitVector<>::randomVector()));
+
+	const unsigned int count = 300; //spans more than one block
+	std::vector<std::pair<BitVector<2*N>, BitMatrix<N> > > objectSearchPairs(count);
+	for (unsigned int i = 0; i < count; ++i) {
+		objectSearchPairs[i].first = BitVector<2*N>::randomVector();
+		objectSearchPairs[i].second = BitMatrix<N>::randomMatrix();
+	}
+	std::vector<BitVector<N> > addresses(count);
+	ks.getMetadataAddresses(&objectSearchPairs[0], &addresses[0], count);
+	for (unsigned int i = 0; i < count; ++i) {
+		ASSERT_TRUE(addresses[i].equals(ks.getMetadataAddress(objectSearchPairs[i])));
+	}
+}
+
+TEST(KryptnosticServerTest, testParallelAddresses){
+	SearchPrivateKey<> sk;
+	PrivateKey<> pk;
+	ClientHashFunction<> chf = sk.getClientHashFunction(pk);
+	KryptnosticServer<> ks(chf, pk.encrypt(BitVector<>::randomVector()));
+
+	const unsigned int count = 300;
+	std::vector<std::pair<BitVector<2*N>, BitMatrix<N> > > objectSearchPairs(count);
+	for (unsigned int i = 0; i < count; ++i) {
+		objectSearchPairs[i].first = BitVector<2*N>::randomVector();
+		objectSearchPairs[i].second = BitMatrix<N>::randomMatrix();
+	}
+	ThreadPool pool(4);
+	std::vector<BitVector<N> > addresses(count);
+	ks.getMetadataAddressesParallel(&objectSearchPairs[0], &addresses[0], count, pool);
+	for (unsigned int i = 0; i < count; ++i) {
+		ASSERT_TRUE(addresses[i].equals(ks.getMetadataAddress(objectSearchPairs[i])));
+	}
+}